@@ -0,0 +1,121 @@
+/*
+	renders the silent tail of a decaying sound with and without DenormalGuard and prints how long
+	each took. the voices are what tsf keeps running through a release: a biquad lowpass with its
+	state ringing down, plus a feedback comb like the reverb send. after the excitation everything
+	decays towards zero and spends most of the run in the denormal range.
+
+	built with `scons denormal_bench=yes`, standalone: no Godot, no TinySoundFont, no SoundFont.
+	don't build it with -ffast-math, which already turns flush-to-zero on at startup.
+*/
+
+#include "../src/denormal_guard.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+static const int VOICE_COUNT = 64;
+static const int BLOCK_SIZE = 64;
+static const int EXCITE_FRAMES = 256;
+static const int TAIL_FRAMES = 44100 * 10;
+static const int COMB_LENGTH = 1557;
+
+struct BenchVoice {
+	// biquad lowpass as in tsf_voice_lowpass
+	double a0, a1, b1, b2;
+	double z1, z2;
+	float level; // release envelope
+	float release;
+};
+
+struct BenchState {
+	BenchVoice voices[VOICE_COUNT];
+	float comb[COMB_LENGTH];
+	int comb_pos;
+	float output[BLOCK_SIZE * 2];
+};
+
+static void bench_setup(BenchState *r_state) {
+	memset(r_state, 0, sizeof(BenchState));
+	for (int i = 0; i < VOICE_COUNT; i++) {
+		BenchVoice &v = r_state->voices[i];
+		// resonant lowpass around 1-3 kHz at 44.1 kHz, coefficients of a stable biquad
+		double k = 0.15 + 0.002 * i;
+		double q = 2.0;
+		double norm = 1.0 / (1.0 + k / q + k * k);
+		v.a0 = k * k * norm;
+		v.a1 = 2.0 * v.a0;
+		v.b1 = 2.0 * (k * k - 1.0) * norm;
+		v.b2 = (1.0 - k / q + k * k) * norm;
+		v.level = 1.0f;
+		v.release = 0.9995f - 0.000002f * i;
+	}
+}
+
+static void bench_render(BenchState *p_state, int p_frames, bool p_excite, unsigned int *p_seed) {
+	for (int offset = 0; offset < p_frames; offset += BLOCK_SIZE) {
+		memset(p_state->output, 0, sizeof(p_state->output));
+		for (int i = 0; i < VOICE_COUNT; i++) {
+			BenchVoice &v = p_state->voices[i];
+			for (int f = 0; f < BLOCK_SIZE; f++) {
+				float input = 0.0f;
+				if (p_excite) {
+					*p_seed = *p_seed * 1664525u + 1013904223u;
+					input = (float)(*p_seed >> 9) / 8388608.0f - 1.0f;
+				}
+				double out = input * v.a0 + v.z1;
+				v.z1 = input * v.a1 + v.z2 - v.b1 * out;
+				v.z2 = input * v.a0 - v.b2 * out;
+				float sample = (float)out * v.level;
+				v.level *= v.release;
+				p_state->output[f * 2] += sample;
+				p_state->output[f * 2 + 1] += sample;
+			}
+		}
+		// reverb-like feedback on the sum
+		for (int f = 0; f < BLOCK_SIZE; f++) {
+			float delayed = p_state->comb[p_state->comb_pos];
+			p_state->comb[p_state->comb_pos] = p_state->output[f * 2] * 0.01f + delayed * 0.84f;
+			p_state->comb_pos = (p_state->comb_pos + 1) % COMB_LENGTH;
+			p_state->output[f * 2] += delayed;
+			p_state->output[f * 2 + 1] += delayed;
+		}
+	}
+}
+
+static double bench_run(bool p_guard, float *r_checksum) {
+	static BenchState state;
+	bench_setup(&state);
+	unsigned int seed = 1;
+	bench_render(&state, EXCITE_FRAMES, true, &seed);
+
+	auto begin = std::chrono::steady_clock::now();
+	if (p_guard) {
+		DenormalGuard denormal_guard;
+		bench_render(&state, TAIL_FRAMES, false, &seed);
+	} else {
+		bench_render(&state, TAIL_FRAMES, false, &seed);
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	// keeps the work from being optimized away
+	*r_checksum = state.output[0] + state.comb[0];
+	return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+int main() {
+	float checksum_plain = 0.0f;
+	float checksum_guarded = 0.0f;
+	// the first run warms up caches and clocks
+	bench_run(false, &checksum_plain);
+
+	double plain = bench_run(false, &checksum_plain);
+	double guarded = bench_run(true, &checksum_guarded);
+
+	printf("%d voices, %.1f s tail\n", VOICE_COUNT, TAIL_FRAMES / 44100.0);
+	printf("without DenormalGuard: %8.2f ms\n", plain);
+	printf("with DenormalGuard:    %8.2f ms\n", guarded);
+	printf("speedup:               %8.2fx\n", guarded > 0.0 ? plain / guarded : 0.0);
+	printf("(checksums %g %g)\n", checksum_plain, checksum_guarded);
+	return 0;
+}
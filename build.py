@@ -6,7 +6,12 @@ import shutil
 from SCons.Variables import BoolVariable
 
 def _setup_options(opts):
-    pass
+    opts.Add(BoolVariable("denormal_bench", "Also build bench/denormal_bench, which times a decaying tail with and without flush-to-zero", False))
 
 def _process_env(self, env, sources, is_gdextension):
-    pass
\ No newline at end of file
+    if env.get("denormal_bench", False):
+        # standalone, it only needs src/denormal_guard.h
+        bench_env = env.Clone()
+        bench_env.Replace(LIBS=[])
+        program = bench_env.Program("bin/denormal_bench", ["bench/denormal_bench.cpp"])
+        bench_env.Default(program)
\ No newline at end of file
@@ -2,6 +2,14 @@ def can_build(env, platform):
     return True
 
 
+def get_opts(platform):
+    from SCons.Variables import BoolVariable
+
+    return [
+        BoolVariable("denormal_bench", "Also build bench/denormal_bench, which times a decaying tail with and without flush-to-zero", False),
+    ]
+
+
 def configure(env):
     pass
 
@@ -10,9 +18,12 @@ def get_doc_classes():
     return [
         "AudioStreamMIDI",
         "AudioStreamPlaybackMIDISF2",
+        "AudioStreamMIDIStem",
+        "AudioStreamPlaybackMIDIStem",
         "AudioStreamSoundfontPlayer",
         "AudioStreamPlaybackSoundfont",
         "MIDI",
+        "MIDIInputRouter",
         "SoundFont2",
         "VirtualKeyboard",
     ]
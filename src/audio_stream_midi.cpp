@@ -1,45 +1,167 @@
 #include "audio_stream_midi.h"
 
 #ifdef _GDEXTENSION
+#include <godot_cpp/classes/engine.hpp>
+#include <godot_cpp/classes/scene_tree.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
 using namespace godot;
 #else
 #include "core/error/error_macros.h"
 #include "core/object/class_db.h"
+#include "core/object/worker_thread_pool.h"
+#include "scene/main/scene_tree.h"
 #endif
 
+#include "audio_stream_midi_stem.h"
+#include "audio_thread_guard.h"
+#include "denormal_guard.h"
+#include "tsf_ext.h"
+
 #include "../thirdparty/tinysoundfont/tsf.h"
 #include "../thirdparty/tinysoundfont/tml.h"
 
+#include <cfloat>
+
 #ifdef _GDEXTENSION
 #define PENDING_MUTEX_LOCK pending_mutex->lock();
 #define PENDING_MUTEX_UNLOCK pending_mutex->unlock();
+#define ADVANCE_MUTEX_LOCK advance_mutex->lock();
+#define ADVANCE_MUTEX_TRY_LOCK advance_mutex->try_lock()
+#define ADVANCE_MUTEX_UNLOCK advance_mutex->unlock();
 #define SNAME(x) x
 #else
 #define PENDING_MUTEX_LOCK pending_mutex.lock();
 #define PENDING_MUTEX_UNLOCK pending_mutex.unlock();
+#define ADVANCE_MUTEX_LOCK advance_mutex.lock();
+#define ADVANCE_MUTEX_TRY_LOCK advance_mutex.try_lock()
+#define ADVANCE_MUTEX_UNLOCK advance_mutex.unlock();
 #endif
 
-bool AudioStreamPlaybackMIDISF2::_has_any_solo() const {
-	for (int i = 0; i < MIDI_CHANNEL_COUNT; i++) {
+void AudioStreamPlaybackMIDISF2::_set_channel_count(int p_count) {
+	// only called before the playback starts mixing
+	channel_count = CLAMP(p_count, 1, MAX_CHANNEL_COUNT);
+	channel_states.resize(channel_count);
+	tsf_ext_reserve_channels(tsf_instance, channel_count);
+	for (int i = 0; i < MAX_CHANNEL_COUNT; i++) {
+		channel_gains[i] = 1.0f;
+		channel_gain_targets[i] = 1.0f;
+		channel_gain_steps[i] = 0.0f;
+		channel_gain_from[i] = 1.0f;
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_update_audible_channels() {
+	// caller holds pending_mutex, so concurrent mute/solo changes can't interleave
+	bool any_solo = false;
+	for (int i = 0; i < channel_count; i++) {
 		if (channel_states[i].solo.is_set()) {
-			return true;
+			any_solo = true;
+			break;
+		}
+	}
+
+	for (int w = 0; w < audible_channels.WORD_COUNT; w++) {
+		uint64_t bits = 0;
+		for (int b = 0; b < 64 && w * 64 + b < channel_count; b++) {
+			const ChannelState &cs = channel_states[w * 64 + b];
+			if (!cs.muted.is_set() && (!any_solo || cs.solo.is_set())) {
+				bits |= uint64_t(1) << b;
+			}
+		}
+		uint64_t silenced = audible_channels.get_word(w) & ~bits;
+		audible_channels.set_word(w, bits);
+
+		// silence only the channels that just became non-audible
+		for (int b = 0; b < 64; b++) {
+			if (silenced & (uint64_t(1) << b)) {
+				pending_messages.push_back({ MESSAGE_CONTROL_CHANGE, w * 64 + b, CONTROLLER_ALL_NOTES_OFF, 0 });
+			}
 		}
 	}
-	return false;
 }
 
-bool AudioStreamPlaybackMIDISF2::_is_channel_audible(int p_channel) const {
-	if (p_channel < 0 || p_channel >= MIDI_CHANNEL_COUNT) {
-		return false;
+void AudioStreamPlaybackMIDISF2::_update_channel_gains() {
+	uint64_t resumed[MAX_CHANNEL_COUNT / 64] = {};
+	bool any_resumed = false;
+
+	channel_gains_active = false;
+	channel_gains_ramping = false;
+	for (int i = 0; i < channel_count; i++) {
+		const ChannelState &cs = channel_states[i];
+		float target = cs.gain.get();
+		if (target != channel_gain_targets[i]) {
+			// even an instant change is ramped, a jump in gain clicks
+			float fade_frames = MAX(cs.gain_fade.get(), MIN_GAIN_FADE_SECONDS) * synth_rate;
+			channel_gain_targets[i] = target;
+			channel_gain_steps[i] = (target - channel_gains[i]) / fade_frames;
+			if (target > 0.0f && _is_channel_suspended(i)) {
+				suspended_channels[i >> 6] &= ~(uint64_t(1) << (i & 63));
+				resumed[i >> 6] |= uint64_t(1) << (i & 63);
+				any_resumed = true;
+			}
+		}
+		if (channel_gains[i] != target) {
+			channel_gains_ramping = true;
+		}
+		if (channel_gains[i] != 1.0f || target != 1.0f) {
+			channel_gains_active = true;
+		}
 	}
-	const ChannelState &cs = channel_states[p_channel];
-	if (cs.muted.is_set()) {
-		return false;
+
+	// the layer comes back in the middle of its notes instead of at the next note on
+	if (any_resumed && params.chase_notes && song_midi && !synth_bypassed) {
+		double tempo_scale = params.tempo_scale;
+		song_midi->get_notes_at(playback_msec, [&](const MIDI::NoteSpan &p_span) {
+			int channel = p_span.note_on->channel;
+			if ((resumed[channel >> 6] >> (channel & 63)) & 1) {
+				_start_note(p_span.note_on, (playback_msec - p_span.start_msec) / 1000.0 / tempo_scale);
+			}
+		});
 	}
-	if (_has_any_solo() && !cs.solo.is_set()) {
-		return false;
+}
+
+void AudioStreamPlaybackMIDISF2::_advance_channel_gains(int p_frames) {
+	bool active = false;
+	bool ramping = false;
+	for (int i = 0; i < channel_count; i++) {
+		float gain = channel_gains[i];
+		float target = channel_gain_targets[i];
+		channel_gain_from[i] = gain;
+		if (gain != target) {
+			gain += channel_gain_steps[i] * p_frames;
+			// stop at the target instead of overshooting it
+			if ((channel_gain_steps[i] > 0.0f) == (gain > target)) {
+				gain = target;
+			}
+			channel_gains[i] = gain;
+			if (gain == 0.0f && channel_states[i].gain_suspend.is_set()) {
+				// the voices still render this block's ramp, they're freed after it
+				suspended_channels[i >> 6] |= uint64_t(1) << (i & 63);
+				suspending_channels[i >> 6] |= uint64_t(1) << (i & 63);
+			}
+		}
+		ramping = ramping || gain != target;
+		if (gain != 1.0f || channel_gain_from[i] != 1.0f) {
+			active = true;
+		}
+	}
+	channel_gains_active = active;
+	channel_gains_ramping = ramping;
+}
+
+void AudioStreamPlaybackMIDISF2::_free_suspended_voices() {
+	for (int w = 0; w < MAX_CHANNEL_COUNT / 64; w++) {
+		uint64_t bits = suspending_channels[w];
+		suspending_channels[w] = 0;
+		for (int b = 0; bits && b < 64; b++) {
+			if (bits & (uint64_t(1) << b)) {
+				tsf_channel_sounds_off_all(tsf_instance, w * 64 + b);
+				held_notes[w * 64 + b][0] = 0;
+				held_notes[w * 64 + b][1] = 0;
+				bits &= ~(uint64_t(1) << b);
+			}
+		}
 	}
-	return true;
 }
 
 void AudioStreamPlaybackMIDISF2::_apply_midi_message(tml_message *p_msg) {
@@ -48,8 +170,11 @@ void AudioStreamPlaybackMIDISF2::_apply_midi_message(tml_message *p_msg) {
 	}
 
 	int channel = p_msg->channel;
-	int transpose = midi_stream->transpose;
-	int ch_transpose = (channel >= 0 && channel < MIDI_CHANNEL_COUNT) ? channel_states[channel].transpose.get() : 0;
+	int transpose = params.transpose;
+	int ch_transpose = (channel >= 0 && channel < channel_count) ? channel_states[channel].transpose.get() : 0;
+	// while playing from the prerender cache notes are only reported, programs and controllers still
+	// reach the synthesizer so it can take over from the cache without replaying the song
+	bool synthesize = !synth_bypassed;
 
 	int param1 = 0;
 	int param2 = 0;
@@ -57,37 +182,38 @@ void AudioStreamPlaybackMIDISF2::_apply_midi_message(tml_message *p_msg) {
 	switch (p_msg->type) {
 		case TML_PROGRAM_CHANGE : {
 			param1 = p_msg->program;
-			int override_prog = (channel >= 0 && channel < MIDI_CHANNEL_COUNT) ? channel_states[channel].program_override.get() : -1;
+			int override_prog = (channel >= 0 && channel < channel_count) ? channel_states[channel].program_override.get() : -1;
 			int actual_program = (override_prog >= 0) ? override_prog : param1;
-			tsf_channel_set_presetnumber(tsf_instance, channel, actual_program, (channel == 9));
+			tsf_channel_set_presetnumber(tsf_instance, channel, actual_program, (channel % 16 == 9));
+			_mirror_message(MESSAGE_PROGRAM_CHANGE, channel, actual_program, 0);
 		} break;
 		case TML_NOTE_ON : {
-			int key = p_msg->key + transpose * 12 + ch_transpose;
-			key = CLAMP(key, 0, 127);
 			param1 = p_msg->key;
 			param2 = p_msg->velocity;
-			if (_is_channel_audible(channel)) {
-				float vel = p_msg->velocity / 127.0f;
-				if (channel >= 0 && channel < MIDI_CHANNEL_COUNT) {
-					vel *= channel_states[channel].volume.get();
-				}
-				tsf_channel_note_on(tsf_instance, channel, key, vel);
+			if (synthesize) {
+				_start_note(p_msg, 0.0);
 			}
 		} break;
 		case TML_NOTE_OFF : {
 			int key = p_msg->key + transpose * 12 + ch_transpose;
 			key = CLAMP(key, 0, 127);
 			param1 = p_msg->key; // emit original key for consistent visualization
-			tsf_channel_note_off(tsf_instance, channel, key);
+			if (synthesize) {
+				tsf_channel_note_off(tsf_instance, channel, key);
+				held_notes[channel][p_msg->key >> 6] &= ~(uint64_t(1) << (p_msg->key & 63));
+			}
 		} break;
 		case TML_PITCH_BEND : {
 			param1 = p_msg->pitch_bend;
 			tsf_channel_set_pitchwheel(tsf_instance, channel, param1);
+			_mirror_message(MESSAGE_PITCH_BEND, channel, param1, 0);
 		} break;
 		case TML_CONTROL_CHANGE : {
 			param1 = p_msg->control;
 			param2 = p_msg->control_value;
 			tsf_channel_midi_control(tsf_instance, channel, param1, param2);
+			effects.control(channel, param1, param2);
+			_mirror_message(MESSAGE_CONTROL_CHANGE, channel, param1, param2);
 		} break;
 		case TML_SET_TEMPO : {
 			int usec_per_beat = tml_get_tempo_value(p_msg);
@@ -114,7 +240,89 @@ void AudioStreamPlaybackMIDISF2::_apply_midi_message(tml_message *p_msg) {
 		}
 	}
 	if (should_emit) {
-		call_deferred(SNAME("emit_signal"), SNAME("applied_midi_message"), (int)p_msg->type, channel, param1, param2);
+		_report_applied_message(p_msg, param1, param2);
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_start_note(const tml_message *p_msg, double p_offset_sec) {
+	int channel = p_msg->channel;
+	if (!audible_channels.has(channel) || _is_channel_suspended(channel)) {
+		return;
+	}
+	int ch_transpose = (channel >= 0 && channel < channel_count) ? channel_states[channel].transpose.get() : 0;
+	int key = p_msg->key + params.transpose * 12 + ch_transpose;
+	key = CLAMP(key, 0, 127);
+	float vel = p_msg->velocity / 127.0f;
+	if (channel >= 0 && channel < channel_count) {
+		vel *= channel_states[channel].volume.get();
+	}
+	if (p_offset_sec > 0.0) {
+		tsf_ext_channel_note_on_at(tsf_instance, channel, key, vel, p_offset_sec);
+	} else {
+		tsf_channel_note_on(tsf_instance, channel, key, vel);
+	}
+	held_notes[channel][p_msg->key >> 6] |= uint64_t(1) << (p_msg->key & 63);
+}
+
+void AudioStreamPlaybackMIDISF2::_report_applied_message(tml_message *p_msg, int p_param1, int p_param2) {
+	int flag = 0;
+	switch (p_msg->type) {
+		case TML_NOTE_ON:
+		case TML_NOTE_OFF:
+			flag = APPLIED_MESSAGE_NOTE;
+			break;
+		case TML_CONTROL_CHANGE:
+			flag = APPLIED_MESSAGE_CONTROL_CHANGE;
+			break;
+		case TML_PROGRAM_CHANGE:
+			flag = APPLIED_MESSAGE_PROGRAM_CHANGE;
+			break;
+		case TML_PITCH_BEND:
+			flag = APPLIED_MESSAGE_PITCH_BEND;
+			break;
+		case TML_SET_TEMPO:
+			flag = APPLIED_MESSAGE_SET_TEMPO;
+			break;
+		default:
+			return;
+	}
+	if (!(applied_message_filter.get() & flag)) {
+		return;
+	}
+
+	int channel = p_msg->channel;
+	if (p_msg->type != TML_SET_TEMPO && !reported_channels.has(channel)) {
+		return;
+	}
+
+	// never call_deferred from here, that allocates a message per event.
+	// with event polling the user drains the ring, otherwise _emit_applied_messages does
+	AppliedMIDIMessage message = { (int)p_msg->type, channel, p_param1, p_param2, (int)p_msg->time };
+	bool pushed = threaded ? held_messages.push({ message, mirror_frame }) : applied_messages.push(message);
+	if (!pushed) {
+		dropped_message_count.increment();
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_connect_signal_dispatch() {
+	if (event_polling || signal_dispatch_connected) {
+		return;
+	}
+#ifdef _GDEXTENSION
+	SceneTree *tree = Object::cast_to<SceneTree>(Engine::get_singleton()->get_main_loop());
+#else
+	SceneTree *tree = SceneTree::get_singleton();
+#endif
+	ERR_FAIL_NULL_MSG(tree, "No SceneTree, applied_midi_message won't be emitted. Use AudioStreamMIDI.event_polling instead.");
+	tree->connect(SNAME("process_frame"), callable_mp(this, &AudioStreamPlaybackMIDISF2::_emit_applied_messages));
+	signal_dispatch_connected = true;
+}
+
+void AudioStreamPlaybackMIDISF2::_emit_applied_messages() {
+	AppliedMIDIMessage msg;
+	uint32_t count = applied_messages.data_left();
+	for (uint32_t i = 0; i < count && applied_messages.pop(msg); i++) {
+		emit_signal(SNAME("applied_midi_message"), msg.type, msg.channel, msg.param1, msg.param2);
 	}
 }
 
@@ -125,29 +333,102 @@ void AudioStreamPlaybackMIDISF2::_process_midi_events(double p_up_to_msec) {
 	}
 }
 
+bool AudioStreamPlaybackMIDISF2::_can_resume_at(double p_time) const {
+	if (!resumable.is_set() || seek_requested.is_set()) {
+		return false;
+	}
+#ifdef _GDEXTENSION
+	double position = _get_playback_position();
+#else
+	double position = get_playback_position();
+#endif
+	return Math::abs(p_time - position) * 1000.0 < RESUME_TOLERANCE_MSEC;
+}
+
 #ifdef _GDEXTENSION
 void AudioStreamPlaybackMIDISF2::_start(double p_from_pos) {
-	active = true;
-	loops = 0;
-	_seek(p_from_pos);
+	// nothing moved since it was left, keep the synthesizer, the cursor and whatever still sounds
+	if (!_can_resume_at(p_from_pos)) {
+		restart_requested.set();
+		_seek(p_from_pos);
+	}
+	_request_play_state(true);
 }
 #else
 void AudioStreamPlaybackMIDISF2::start(double p_from_pos) {
-	active = true;
-	loops = 0;
-	seek(p_from_pos);
+	// nothing moved since it was left, keep the synthesizer, the cursor and whatever still sounds
+	if (!_can_resume_at(p_from_pos)) {
+		restart_requested.set();
+		seek(p_from_pos);
+	}
+	_request_play_state(true);
 }
 #endif
 
+void AudioStreamPlaybackMIDISF2::_request_play_state(bool p_playing) {
+	// start and stop come from one thread at a time, the sequence only has to differ from the last
+	uint32_t sequence = (play_request.get() >> 1) + 1;
+	play_request.set((sequence << 1) | (p_playing ? 1 : 0));
+	if (threaded) {
+		_worker_post();
+	}
+}
+
 #ifdef _GDEXTENSION
 void AudioStreamPlaybackMIDISF2::_stop() {
 #else
 void AudioStreamPlaybackMIDISF2::stop() {
 #endif
-	active = false;
-	if (tsf_instance) {
-		tsf_note_off_all(tsf_instance);
+	// a start or transition that wasn't applied yet is dropped with it
+	resumable.clear();
+	transition_requested.clear();
+	restart_requested.clear();
+	seek_requested.clear();
+	stop_requested.set();
+	server_mixed.clear();
+	_request_play_state(false);
+}
+
+void AudioStreamPlaybackMIDISF2::_snapshot_parameters() {
+	const AudioStreamMIDI *stream = midi_stream.ptr();
+	params.tempo_scale = stream->tempo_scale.get();
+	params.transpose = stream->transpose.get();
+	params.loop = stream->loop.is_set();
+	params.loop_offset_msec = stream->loop_offset.get() * 1000.0;
+	params.effects_enabled = stream->effects_enabled.is_set();
+	params.chase_notes = stream->chase_notes.is_set();
+	params.voice_cull_gain = stream->voice_cull_gain.get();
+}
+
+bool AudioStreamPlaybackMIDISF2::_apply_song_commands() {
+	// read before the other commands, whatever start or stop posted ahead of it is seen below
+	uint32_t request = play_request.get();
+	if (request != applied_play_request.get()) {
+		applied_play_request.set(request);
+		active.set_to(request & 1);
+	}
+	if (stop_requested.is_set()) {
+		stop_requested.clear();
+		if (tsf_instance) {
+			tsf_note_off_all(tsf_instance);
+		}
+		memset(held_notes, 0, sizeof(held_notes));
+		transition_scheduled = false;
+		transition_active.clear();
+		live_input_used.clear();
 	}
+	if (!seek_requested.is_set()) {
+		return false;
+	}
+	seek_requested.clear();
+	if (restart_requested.is_set()) {
+		restart_requested.clear();
+		loops.set(0);
+	}
+	// seeking resets the synthesizer, so whatever live input did is gone and the cache is usable again
+	live_input_used.clear();
+	_seek_to_msec(seek_target_msec.get());
+	return true;
 }
 
 #ifdef _GDEXTENSION
@@ -155,7 +436,12 @@ bool AudioStreamPlaybackMIDISF2::_is_playing() const {
 #else
 bool AudioStreamPlaybackMIDISF2::is_playing() const {
 #endif
-	return active;
+	// a start or stop not applied yet already counts
+	uint32_t request = play_request.get();
+	if (request != applied_play_request.get()) {
+		return request & 1;
+	}
+	return active.is_set();
 }
 
 #ifdef _GDEXTENSION
@@ -163,7 +449,7 @@ int32_t AudioStreamPlaybackMIDISF2::_get_loop_count() const {
 #else
 int AudioStreamPlaybackMIDISF2::get_loop_count() const {
 #endif
-	return loops;
+	return loops.get();
 }
 
 #ifdef _GDEXTENSION
@@ -171,7 +457,13 @@ double AudioStreamPlaybackMIDISF2::_get_playback_position() const {
 #else
 double AudioStreamPlaybackMIDISF2::get_playback_position() const {
 #endif
-	return playback_msec / 1000.0;
+	double msec = reported_msec.get();
+	if (threaded) {
+		// the worker is ahead by whatever sits in the ring
+		double queued_msec = render_ring.data_left() / mix_rate * 1000.0 * midi_stream->tempo_scale.get();
+		return MAX(msec - queued_msec, 0.0) / 1000.0;
+	}
+	return msec / 1000.0;
 }
 
 #ifdef _GDEXTENSION
@@ -179,13 +471,26 @@ void AudioStreamPlaybackMIDISF2::_seek(double p_time) {
 #else
 void AudioStreamPlaybackMIDISF2::seek(double p_time) {
 #endif
+	seek_target_msec.set(p_time * 1000.0);
+	seek_requested.set();
+	resumable.set();
+	// reported right away, the song gets there with the next block
+	reported_msec.set(p_time * 1000.0);
+	if (threaded) {
+		_worker_post();
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_seek_to_msec(double p_msec) {
 	if (!tsf_instance || !first_msg) {
 		return;
 	}
 
-	tsf_reset(tsf_instance);
+	tsf_ext_reset(tsf_instance);
+	effects.reset();
+	memset(held_notes, 0, sizeof(held_notes));
 
-	double target_msec = p_time * 1000.0;
+	double target_msec = p_msec;
 
 	suppress_signals = true;
 
@@ -204,13 +509,261 @@ void AudioStreamPlaybackMIDISF2::seek(double p_time) {
 		msg = msg->next;
 	}
 
+	// notes that began before the target and still sound there are started where they'd be by now,
+	// the note index keeps this to the notes around the target instead of replaying the song
+	if (params.chase_notes && song_midi && !synth_bypassed) {
+		double tempo_scale = params.tempo_scale;
+		song_midi->get_notes_at(target_msec, [&](const MIDI::NoteSpan &p_span) {
+			_start_note(p_span.note_on, (target_msec - p_span.start_msec) / 1000.0 / tempo_scale);
+		});
+	}
+
 	suppress_signals = false;
 
 	current_msg = msg;
 	playback_msec = target_msec;
+	reported_msec.set(playback_msec);
+
+	frames_mixed = (uint32_t)(mix_rate * target_msec / 1000.0);
+	prerender_frame = (uint32_t)(mix_rate * target_msec / 1000.0 / params.tempo_scale);
+
+	if (transition_scheduled) {
+		_update_transition_msec();
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_setup_loop(double p_start_msec, double p_end_msec) {
+	ERR_FAIL_NULL_MSG(song_midi, "The loop is set up from the song, set it first.");
+	loop_start_msec = p_start_msec;
+	loop_end_msec = p_end_msec;
+	gapless_loop = true;
+
+	// on a wrap only the state at the loop start is applied instead of replaying everything from the beginning
+	loop_start_msg = song_midi->get_state_before(p_start_msec, loop_state);
+}
+
+void AudioStreamPlaybackMIDISF2::_release_held_notes() {
+	int transpose = params.transpose;
+	for (int channel = 0; channel < channel_count; channel++) {
+		int ch_transpose = channel_states[channel].transpose.get();
+		for (int word = 0; word < 2; word++) {
+			uint64_t bits = held_notes[channel][word];
+			for (int bit = 0; bits; bit++, bits >>= 1) {
+				if (bits & 1) {
+					int key = CLAMP(word * 64 + bit + transpose * 12 + ch_transpose, 0, 127);
+					tsf_channel_note_off(tsf_instance, channel, key);
+				}
+			}
+			held_notes[channel][word] = 0;
+		}
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_wrap_loop() {
+	loops.increment();
+
+	// their note-offs lie past the loop end, release them here and let the tails ring into the loop start
+	_release_held_notes();
+
+	suppress_signals = true;
+	for (tml_message *msg : loop_state) {
+		_apply_midi_message(msg);
+	}
+	suppress_signals = false;
+
+	current_msg = loop_start_msg;
+	// keep the part of the last block that went past the loop end, so loops don't drift
+	playback_msec = loop_start_msec + MAX(playback_msec - loop_end_msec, 0.0);
+	prerender_frame = (uint32_t)(mix_rate * playback_msec / 1000.0 / params.tempo_scale);
+
+	if (transition_scheduled) {
+		_update_transition_msec();
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_schedule_transition() {
+	PENDING_MUTEX_LOCK
+	transition = pending_transition;
+	transition_requested.clear();
+	PENDING_MUTEX_UNLOCK
+
+	// the fade is given in output seconds
+	transition_fade_msec = transition.fade_seconds * 1000.0 * params.tempo_scale;
+	transition_scheduled = true;
+	_update_transition_msec();
+}
+
+void AudioStreamPlaybackMIDISF2::_update_transition_msec() {
+	// the earliest switch that still leaves room for the whole fade
+	double earliest_msec = playback_msec + transition_fade_msec;
+	switch (transition.sync) {
+		case TRANSITION_IMMEDIATE: {
+			transition_msec = earliest_msec;
+		} break;
+		case TRANSITION_NEXT_BEAT:
+		case TRANSITION_NEXT_BAR: {
+			double unit = transition.sync == TRANSITION_NEXT_BEAT ? 1.0 : (double)transition.beats_per_bar;
+			double beat = song_midi->get_beat_at(earliest_msec / 1000.0);
+			// a boundary right at the position is the one to take, not the one after it
+			double next = Math::ceil(beat / unit - 0.000001) * unit;
+			transition_msec = song_midi->get_beat_time(next) * 1000.0;
+		} break;
+		case TRANSITION_SONG_END: {
+			// a beat loop never gets to the end of the file
+			double end_msec = gapless_loop && params.loop ? loop_end_msec : (double)song_midi->get_length_msec();
+			transition_msec = MAX(end_msec, earliest_msec);
+		} break;
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_apply_transition() {
+	double overshoot = MAX(playback_msec - transition_msec, 0.0);
+
+	if (transition_fade_msec > 0.0) {
+		// faded out already, whatever still sounds would come back at full level
+		tsf_ext_reset(tsf_instance);
+		effects.reset();
+		memset(held_notes, 0, sizeof(held_notes));
+	} else {
+		// hand the channels over: the outgoing notes are released and ring on,
+		// the incoming song starts from default programs and controllers
+		_release_held_notes();
+		tsf_ext_reset_channels(tsf_instance);
+		effects.clear_sends();
+	}
+
+	song_midi = transition.midi;
+	song_replaced = true;
+	gapless_loop = false;
+	first_msg = song_midi->get_midi();
+	current_msg = first_msg;
+	playback_msec = overshoot;
+	frames_mixed = (uint32_t)(mix_rate * playback_msec / 1000.0);
+	prerender_frame = 0;
+	loops.set(0);
+
+	transition_scheduled = false;
+	transition_active.clear();
+}
+
+void AudioStreamPlaybackMIDISF2::_apply_transition_fade(AudioFrame *p_buffer, int p_frames, double p_start_msec) {
+	if (playback_msec <= transition_msec - transition_fade_msec) {
+		return;
+	}
+	float from = (float)CLAMP((transition_msec - p_start_msec) / transition_fade_msec, 0.0, 1.0);
+	float to = (float)CLAMP((transition_msec - playback_msec) / transition_fade_msec, 0.0, 1.0);
+	float step = (to - from) / p_frames;
+	for (int i = 0; i < p_frames; i++) {
+		float gain = from + step * (i + 1);
+		p_buffer[i].left *= gain;
+		p_buffer[i].right *= gain;
+	}
+}
+
+double AudioStreamPlaybackMIDISF2::_get_boundary_msec(bool p_use_loop) const {
+	double boundary = p_use_loop && gapless_loop ? loop_end_msec : DBL_MAX;
+	if (transition_scheduled) {
+		boundary = MIN(boundary, transition_msec);
+	}
+	return boundary;
+}
 
-	float sample_rate = AudioServer::get_singleton()->get_mix_rate();
-	frames_mixed = (uint32_t)(sample_rate * p_time);
+void AudioStreamPlaybackMIDISF2::_cross_boundary() {
+	// a transition on the same frame as the loop end wins
+	if (transition_scheduled && playback_msec >= transition_msec - 0.001) {
+		_apply_transition();
+	} else {
+		_wrap_loop();
+	}
+}
+
+bool AudioStreamPlaybackMIDISF2::_can_use_prerender(int p_frames) const {
+	const MIDIPrerenderCache *cache = prerender_cache;
+	if (!cache || cache->invalid.is_set() || channels_modified.is_set() || live_input_used.is_set()) {
+		return false;
+	}
+	// the cache holds the song once, without the tails carried over a gapless wrap
+	if (gapless_loop && params.loop && loop_allowed) {
+		return false;
+	}
+	// the cache holds the stream's own song, and the fade is applied to the synthesized output
+	if (song_replaced || transition_scheduled || transition_requested.is_set()) {
+		return false;
+	}
+	// fading back to unity, the targets already are
+	if (channel_gains_active) {
+		return false;
+	}
+	if (cache->complete.is_set()) {
+		return true;
+	}
+	// switching over drops the live voices, only do it once the render is comfortably ahead
+	uint32_t lead = using_prerender ? p_frames : p_frames + PRERENDER_MIN_LEAD_FRAMES;
+	return cache->frames_ready.get() >= prerender_frame + lead;
+}
+
+void AudioStreamPlaybackMIDISF2::_update_prerender_state(int p_frames) {
+	bool use = _can_use_prerender(p_frames);
+	if (use == using_prerender) {
+		return;
+	}
+	using_prerender = use;
+	if (use) {
+		// the cache already contains whatever is sounding now. the channels keep their programs
+		// and controllers, which follow the song while it's bypassed
+		tsf_ext_kill_voices(tsf_instance);
+		effects.reset();
+		memset(held_notes, 0, sizeof(held_notes));
+		synth_bypassed = true;
+	} else {
+		// the channels are already where the song is, only the notes sounding now are missing.
+		// chased regardless of chase_notes, the cache had them playing
+		synth_bypassed = false;
+		if (song_midi) {
+			double tempo_scale = params.tempo_scale;
+			song_midi->get_notes_at(playback_msec, [&](const MIDI::NoteSpan &p_span) {
+				_start_note(p_span.note_on, (playback_msec - p_span.start_msec) / 1000.0 / tempo_scale);
+			});
+		}
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_copy_prerendered(AudioFrame *p_buffer, int p_frames) {
+	const MIDIPrerenderCache *cache = prerender_cache;
+	uint32_t ready = cache->frames_ready.get();
+	const int16_t *src = cache->samples.ptr();
+	for (int i = 0; i < p_frames; i++) {
+		uint32_t frame = prerender_frame + i;
+		if (frame < ready) {
+			p_buffer[i].left = src[frame * 2] * (1.0f / 32768.0f);
+			p_buffer[i].right = src[frame * 2 + 1] * (1.0f / 32768.0f);
+		} else {
+			p_buffer[i].left = 0.0f;
+			p_buffer[i].right = 0.0f;
+		}
+	}
+}
+
+int AudioStreamPlaybackMIDISF2::_get_idle_frames(int p_frames, float p_tempo_scale, double p_end_msec) const {
+	// without a next event the song is about to finish, let the normal path handle it.
+	// gain ramps only advance with rendered blocks, a fade has to finish before skipping
+	if (!current_msg || channel_gains_ramping || tsf_active_voice_count(tsf_instance) > 0 || (params.effects_enabled && effects.has_tail())) {
+		return 0;
+	}
+	// whole blocks only, and the block that reaches the event (or the loop end) is rendered normally,
+	// so events are applied at the same block boundaries as without the skip
+	double frames_to_event = (MIN((double)current_msg->time, p_end_msec) - playback_msec) / 1000.0 / p_tempo_scale * mix_rate;
+	int blocks = MIN((int)Math::ceil(frames_to_event / MIX_BLOCK_SIZE) - 1, p_frames / MIX_BLOCK_SIZE);
+	return MAX(blocks, 0) * MIX_BLOCK_SIZE;
+}
+
+void AudioStreamPlaybackMIDISF2::_update_channels_modified() {
+	bool modified = false;
+	for (int i = 0; i < channel_count && !modified; i++) {
+		const ChannelState &cs = channel_states[i];
+		modified = cs.muted.is_set() || cs.solo.is_set() || cs.transpose.get() != 0 || cs.volume.get() != 1.0f || cs.gain.get() != 1.0f || cs.program_override.get() >= 0 || channel_groups[i].get() != 0;
+	}
+	channels_modified.set_to(modified);
 }
 
 #ifdef _GDEXTENSION
@@ -218,60 +771,442 @@ int32_t AudioStreamPlaybackMIDISF2::_mix(AudioFrame *p_buffer, float p_rate_scal
 #else
 int AudioStreamPlaybackMIDISF2::mix(AudioFrame *p_buffer, float p_rate_scale, int p_frames) {
 #endif
-	if (!active || !tsf_instance) {
+	AudioThreadGuard guard;
+	DenormalGuard denormal_guard;
+
+	if (threaded) {
+		_mix_threaded(p_buffer, p_frames);
+	} else if (events_only) {
+		server_mixed.set();
+		// never wait on the audio thread, an advance() in progress just makes this mix silent
+		if (ADVANCE_MUTEX_TRY_LOCK) {
+			_snapshot_parameters();
+			_apply_song_commands();
+			// pushed messages are only recorded, they have no synthesizer to go to
+			_flush_pending_messages();
+			_render(p_buffer, p_frames);
+			ADVANCE_MUTEX_UNLOCK
+		} else {
+			for (int i = 0; i < p_frames; i++) {
+				p_buffer[i].left = 0.0f;
+				p_buffer[i].right = 0.0f;
+			}
+		}
+	} else {
+		_snapshot_parameters();
+		_apply_song_commands();
+
+		if (active.is_set() && tsf_instance) {
+			// decided before flushing, pushed messages need the synthesizer
+			_update_prerender_state(p_frames);
+			_flush_pending_messages();
+		}
+		_render(p_buffer, p_frames);
+	}
+
+	record_clock += p_frames;
+	recorder.set_clock(record_clock);
+	return p_frames;
+}
+
+void AudioStreamPlaybackMIDISF2::_render(AudioFrame *p_buffer, int p_frames) {
+	if (!active.is_set() || !tsf_instance) {
 		for (int i = 0; i < p_frames; i++) {
 			p_buffer[i].left = 0.0f;
 			p_buffer[i].right = 0.0f;
 		}
-		return p_frames;
+		return;
+	}
+
+	if (!using_prerender) {
+		// inaudible voices would otherwise render until their envelope ends and take up voice slots
+		culled_voice_count.add(tsf_ext_cull_voices(tsf_instance, params.voice_cull_gain));
 	}
 
-	float sample_rate = AudioServer::get_singleton()->get_mix_rate();
+	if (transition_requested.is_set()) {
+		_schedule_transition();
+	}
+	if (channel_gains_changed.is_set()) {
+		channel_gains_changed.clear();
+		_update_channel_gains();
+	}
+
+	float sample_rate = mix_rate;
 
-	float tempo_scale = midi_stream->tempo_scale;
-	bool use_loop = midi_stream->loop;
+	float tempo_scale = params.tempo_scale;
+	bool use_loop = params.loop && loop_allowed;
 
 	int frames_remaining = p_frames;
 	int offset = 0;
 
-	const int BLOCK_SIZE = 64;
+	// the worker renders ahead of the output, stems would run early, keep them in the main mix
+	bool render_stems = stems_active.is_set() && !threaded;
 
-	_flush_pending_messages();
+	while (frames_remaining > 0 && active.is_set()) {
+		double boundary_msec = _get_boundary_msec(use_loop);
+
+		// rests: nothing sounds until the next event, skip the synthesizer and the per-block event checks
+		int idle = (using_prerender || render_stems) ? 0 : _get_idle_frames(frames_remaining, tempo_scale, boundary_msec);
+		if (idle > 0) {
+			for (int i = offset; i < offset + idle; i++) {
+				p_buffer[i].left = 0.0f;
+				p_buffer[i].right = 0.0f;
+			}
+			playback_msec += (double)idle / sample_rate * 1000.0 * tempo_scale;
+			prerender_frame += idle;
+			frames_mixed += idle;
+			offset += idle;
+			frames_remaining -= idle;
+			for (int i = 0; i < MAX_CHANNEL_GROUPS; i++) {
+				upsample_states[i] = LinearUpsampler::State();
+			}
+			continue;
+		}
 
-	while (frames_remaining > 0 && active) {
-		int block = MIN(frames_remaining, BLOCK_SIZE);
+		int block = MIN(frames_remaining, MIX_BLOCK_SIZE);
+
+		bool at_boundary = false;
+		if (boundary_msec < DBL_MAX) {
+			// shorten the block so it ends on the first frame at or past the loop end or transition
+			double frames_to_end = (boundary_msec - playback_msec) / 1000.0 / tempo_scale * sample_rate;
+			if (frames_to_end <= block) {
+				block = CLAMP((int)Math::ceil(frames_to_end), 0, block);
+				at_boundary = true;
+			}
+			if (block == 0) {
+				_cross_boundary();
+				continue;
+			}
+		}
 
+		double block_start_msec = playback_msec;
 		double block_msec = (double)block / sample_rate * 1000.0 * tempo_scale;
 		playback_msec += block_msec;
 
-		_process_midi_events(playback_msec);
+		mirror_frame = render_ring.get_write_position() + offset;
+		// events at the boundary belong to what comes after it
+		_process_midi_events(at_boundary ? boundary_msec - 0.001 : playback_msec);
 
-		tsf_render_float(tsf_instance, (float *)&p_buffer[offset], block, 0);
+		bool finished = false;
+		if (events_only) {
+			for (int i = offset; i < offset + block; i++) {
+				p_buffer[i].left = 0.0f;
+				p_buffer[i].right = 0.0f;
+			}
+			finished = !current_msg;
+		} else if (using_prerender) {
+			_copy_prerendered(&p_buffer[offset], block);
+			prerender_frame += block;
+			finished = prerender_cache->complete.is_set() && prerender_frame >= prerender_cache->frame_count.get();
+		} else {
+			bool render_effects = params.effects_enabled && effects.is_active();
+			_synthesize(&p_buffer[offset], block, render_stems, render_effects);
+			prerender_frame += block;
+			finished = !current_msg && tsf_active_voice_count(tsf_instance) == 0 && !(render_effects && effects.has_tail());
+			if (transition_scheduled && transition_fade_msec > 0.0) {
+				// the main output only, stems already went to their rings
+				_apply_transition_fade(&p_buffer[offset], block, block_start_msec);
+			}
+		}
 
 		frames_mixed += block;
 		offset += block;
 		frames_remaining -= block;
 
-		if (!current_msg && tsf_active_voice_count(tsf_instance) == 0) {
-			if (use_loop) {
-				loops++;
-#ifdef _GDEXTENSION
-				_seek(midi_stream->loop_offset);
-#else
-				seek(midi_stream->loop_offset);
-#endif
+		if (at_boundary) {
+			_cross_boundary();
+		} else if (finished) {
+			if (transition_scheduled) {
+				// the song ended before the boundary, the next one starts right away
+				transition_msec = playback_msec;
+				_apply_transition();
+			} else if (use_loop) {
+				loops.increment();
+				live_input_used.clear();
+				_seek_to_msec(gapless_loop ? loop_start_msec : params.loop_offset_msec);
 			} else {
 				for (int i = offset; i < p_frames; i++) {
 					p_buffer[i].left = 0.0f;
 					p_buffer[i].right = 0.0f;
 				}
-				active = false;
+				// a start posted meanwhile is a newer play_request, the next block applies it
+				active.clear();
+				resumable.clear();
 				break;
 			}
 		}
 	}
 
-	return p_frames;
+	reported_msec.set(playback_msec);
+}
+
+void AudioStreamPlaybackMIDISF2::_synthesize(AudioFrame *p_buffer, int p_frames, bool p_stems, bool p_effects) {
+	if (!upsampling) {
+		_render_voices(p_buffer, p_frames, p_stems, p_effects);
+		for (int i = 1; p_stems && i < MAX_CHANNEL_GROUPS; i++) {
+			if (_is_stem_listened(i)) {
+				_write_stem(i, (const AudioFrame *)stem_block[i], p_buffer, p_frames);
+			}
+		}
+		return;
+	}
+
+	int count = upsampler.get_input_count(p_frames);
+	_render_voices(synth_block, count, p_stems, p_effects);
+	upsampler.process(upsample_states[0], synth_block, p_buffer, p_frames);
+	for (int i = 1; p_stems && i < MAX_CHANNEL_GROUPS; i++) {
+		if (_is_stem_listened(i)) {
+			upsampler.process(upsample_states[i], (const AudioFrame *)stem_block[i], stem_upsampled, p_frames);
+			_write_stem(i, stem_upsampled, p_buffer, p_frames);
+		}
+	}
+	upsampler.advance(p_frames);
+}
+
+void AudioStreamPlaybackMIDISF2::_render_voices(AudioFrame *p_buffer, int p_frames, bool p_stems, bool p_effects) {
+	static_assert(MIX_BLOCK_SIZE <= MIDIEffects::MAX_BLOCK_SIZE, "effect send buffers hold one mix block");
+
+	if (!p_stems && !p_effects && !channel_gains_active) {
+		tsf_ext_render_float(tsf_instance, (float *)p_buffer, p_frames, 0, quality);
+		return;
+	}
+
+	// decided once per block, so a stem that starts or stops playing mid-block can't split it
+	bool listened[MAX_CHANNEL_GROUPS] = { true };
+	float *outputs[MAX_CHANNEL_GROUPS];
+	outputs[0] = (float *)p_buffer;
+	for (int i = 1; i < MAX_CHANNEL_GROUPS; i++) {
+		listened[i] = p_stems && _is_stem_listened(i);
+		outputs[i] = listened[i] ? stem_block[i] : outputs[0];
+	}
+	if (p_stems) {
+		for (int i = 0; i < channel_count; i++) {
+			uint8_t group = channel_groups[i].get();
+			render_groups[i] = listened[group] ? group : 0;
+		}
+	}
+
+	tsf_ext_sends sends;
+	if (p_effects) {
+		sends.reverb_levels = effects.get_reverb_levels();
+		sends.chorus_levels = effects.get_chorus_levels();
+		sends.channel_count = MIN(channel_count, (int)MIDIEffects::MAX_CHANNELS);
+		sends.reverb = effects.reverb_send;
+		sends.chorus = effects.chorus_send;
+		sends.scratch = effects.scratch;
+	}
+
+	tsf_ext_gains gains;
+	bool use_gains = channel_gains_active;
+	if (use_gains) {
+		_advance_channel_gains(p_frames);
+		gains.from = channel_gain_from;
+		gains.to = channel_gains;
+		gains.channel_count = channel_count;
+		gains.scratch = effects.scratch;
+	}
+
+	bool sent = tsf_ext_render_groups(tsf_instance, outputs, MAX_CHANNEL_GROUPS, render_groups, channel_count, p_effects ? &sends : nullptr, use_gains ? &gains : nullptr, p_frames, quality);
+	if (use_gains) {
+		_free_suspended_voices();
+	}
+	if (p_effects) {
+		// the returns go to the main output, stems stay dry
+		effects.process((float *)p_buffer, p_frames, sent);
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_mix_threaded(AudioFrame *p_buffer, int p_frames) {
+	// a seek or start on the worker makes everything rendered before it stale. the marker may be
+	// published after the last mix already read past it, skip_to() then leaves the position alone
+	uint32_t sequence = worker_seek_sequence.get();
+	if (sequence != consumed_seek_sequence) {
+		render_ring.skip_to(worker_seek_marker.get());
+		consumed_seek_sequence = sequence;
+	}
+
+	uint32_t position = render_ring.get_read_position();
+	_apply_mirrored_messages(position + p_frames);
+	_forward_applied_messages(position, position + p_frames);
+
+	// live input skips the lookahead and goes to its own synthesizer
+	_flush_pending_messages();
+
+	uint32_t count = render_ring.read(p_buffer, p_frames);
+	for (int i = count; i < p_frames; i++) {
+		p_buffer[i].left = 0.0f;
+		p_buffer[i].right = 0.0f;
+	}
+	if ((int)count < p_frames && active.is_set()) {
+		underrun_count.increment();
+	}
+
+	if (live_tsf) {
+		culled_voice_count.add(tsf_ext_cull_voices(live_tsf, midi_stream->voice_cull_gain.get()));
+		tsf_ext_render_float(live_tsf, (float *)p_buffer, p_frames, 1, quality);
+	}
+
+	_worker_post();
+}
+
+void AudioStreamPlaybackMIDISF2::_apply_mirrored_messages(uint32_t p_up_to_frame) {
+	while (true) {
+		if (!has_mirror_next) {
+			if (!mirror_messages.pop(mirror_next)) {
+				return;
+			}
+			has_mirror_next = true;
+		}
+		// free-running positions, compare the distance
+		if ((int32_t)(mirror_next.frame - p_up_to_frame) >= 0) {
+			return;
+		}
+		has_mirror_next = false;
+
+		const MirroredMessage &m = mirror_next;
+		switch (m.type) {
+			case MESSAGE_PROGRAM_CHANGE:
+				tsf_channel_set_presetnumber(live_tsf, m.channel, m.param1, (m.channel % 16 == 9));
+				break;
+			case MESSAGE_PITCH_BEND:
+				tsf_channel_set_pitchwheel(live_tsf, m.channel, m.param1);
+				break;
+			case MESSAGE_CONTROL_CHANGE:
+				tsf_channel_midi_control(live_tsf, m.channel, m.param1, m.param2);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_forward_applied_messages(uint32_t p_from_frame, uint32_t p_up_to_frame) {
+	while (true) {
+		if (!has_held_next) {
+			if (!held_messages.pop(held_next)) {
+				return;
+			}
+			has_held_next = true;
+		}
+		if ((int32_t)(held_next.frame - p_up_to_frame) >= 0) {
+			return;
+		}
+		has_held_next = false;
+
+		// rendered before a seek and skipped, never heard
+		if ((int32_t)(held_next.frame - p_from_frame) < 0) {
+			continue;
+		}
+		if (!applied_messages.push(held_next.message)) {
+			dropped_message_count.increment();
+		}
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_mirror_message(MIDIMessageType p_type, int p_channel, int p_param1, int p_param2) {
+	// only the worker produces, the audio thread applies them once playback reaches mirror_frame
+	if (threaded && !mirror_messages.push({ p_type, p_channel, p_param1, p_param2, mirror_frame })) {
+		dropped_message_count.increment();
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_sync_worker_audible_channels() {
+	// mute/solo only queue ALL_NOTES_OFF for the live synthesizer, silence the song here
+	for (int w = 0; w < audible_channels.WORD_COUNT; w++) {
+		uint64_t bits = audible_channels.get_word(w);
+		uint64_t silenced = worker_audible_words[w] & ~bits;
+		worker_audible_words[w] = bits;
+		for (int b = 0; silenced && b < 64; b++) {
+			if (silenced & (uint64_t(1) << b)) {
+				tsf_channel_note_off_all(tsf_instance, w * 64 + b);
+				silenced &= ~(uint64_t(1) << b);
+			}
+		}
+	}
+}
+
+void AudioStreamPlaybackMIDISF2::_worker_loop() {
+	AudioThreadGuard guard;
+	DenormalGuard denormal_guard;
+	AudioFrame buffer[WORKER_CHUNK_FRAMES];
+
+	while (!worker_exit.is_set()) {
+		_snapshot_parameters();
+		// controllers restored by a seek reach live_tsf as soon as the new frames play
+		mirror_frame = render_ring.get_write_position();
+		if (_apply_song_commands()) {
+			worker_seek_marker.set(mirror_frame);
+			worker_seek_sequence.increment();
+		}
+		_sync_worker_audible_channels();
+
+		if (!active.is_set() || render_ring.data_left() >= worker_lookahead_frames || render_ring.space_left() < (uint32_t)WORKER_CHUNK_FRAMES) {
+			_worker_wait();
+			continue;
+		}
+
+		_update_prerender_state(WORKER_CHUNK_FRAMES);
+		_render(buffer, WORKER_CHUNK_FRAMES);
+		render_ring.write(buffer, WORKER_CHUNK_FRAMES);
+	}
+}
+
+#ifndef _GDEXTENSION
+void AudioStreamPlaybackMIDISF2::_worker_thread_func(void *p_userdata) {
+	static_cast<AudioStreamPlaybackMIDISF2 *>(p_userdata)->_worker_loop();
+}
+#endif
+
+void AudioStreamPlaybackMIDISF2::_worker_post() {
+#ifdef _GDEXTENSION
+	worker_semaphore->post();
+#else
+	worker_semaphore.post();
+#endif
+}
+
+void AudioStreamPlaybackMIDISF2::_worker_wait() {
+#ifdef _GDEXTENSION
+	worker_semaphore->wait();
+#else
+	worker_semaphore.wait();
+#endif
+}
+
+void AudioStreamPlaybackMIDISF2::_start_worker(float p_lookahead_msec, tsf *p_live_tsf) {
+	threaded = true;
+	live_tsf = p_live_tsf;
+	worker_lookahead_frames = MAX((uint32_t)(p_lookahead_msec * mix_rate / 1000.0f), (uint32_t)WORKER_CHUNK_FRAMES);
+	render_ring.resize(worker_lookahead_frames + WORKER_CHUNK_FRAMES);
+	mirror_messages.resize(MIRROR_BUFFER_SIZE);
+	held_messages.resize(applied_messages.capacity());
+	for (int w = 0; w < audible_channels.WORD_COUNT; w++) {
+		worker_audible_words[w] = audible_channels.get_word(w);
+	}
+
+#ifdef _GDEXTENSION
+	worker_semaphore.instantiate();
+	worker_thread.instantiate();
+	worker_thread->start(callable_mp(this, &AudioStreamPlaybackMIDISF2::_worker_loop), Thread::PRIORITY_HIGH);
+#else
+	Thread::Settings settings;
+	settings.priority = Thread::PRIORITY_HIGH;
+	worker_thread.start(&AudioStreamPlaybackMIDISF2::_worker_thread_func, this, settings);
+#endif
+}
+
+void AudioStreamPlaybackMIDISF2::_stop_worker() {
+	if (!threaded) {
+		return;
+	}
+	worker_exit.set();
+	_worker_post();
+#ifdef _GDEXTENSION
+	worker_thread->wait_to_finish();
+#else
+	worker_thread.wait_to_finish();
+#endif
+	threaded = false;
 }
 
 #ifdef _GDEXTENSION
@@ -282,6 +1217,13 @@ void AudioStreamPlaybackMIDISF2::tag_used_streams() {
 #endif
 
 AudioStreamPlaybackMIDISF2::~AudioStreamPlaybackMIDISF2() {
+	_stop_worker();
+	if (live_tsf) {
+		tsf_close(live_tsf);
+		live_tsf = nullptr;
+	}
+	MIDIPrerenderCache::release(prerender_cache);
+	prerender_cache = nullptr;
 	if (tsf_instance) {
 		tsf_close(tsf_instance);
 		tsf_instance = nullptr;
@@ -289,95 +1231,205 @@ AudioStreamPlaybackMIDISF2::~AudioStreamPlaybackMIDISF2() {
 }
 
 void AudioStreamPlaybackMIDISF2::push_midi_message(MIDIMessageType p_type, int p_channel, int p_param1, int p_param2) {
+	ERR_FAIL_INDEX(p_channel, channel_count);
+	if (!threaded) {
+		live_input_used.set();
+	}
 	PENDING_MUTEX_LOCK
 	pending_messages.push_back({ p_type, p_channel, p_param1, p_param2 });
 	PENDING_MUTEX_UNLOCK
 }
 
-void AudioStreamPlaybackMIDISF2::set_channel_muted(int p_channel, bool p_muted) {
-	ERR_FAIL_INDEX(p_channel, MIDI_CHANNEL_COUNT);
-	if (p_muted) {
-		channel_states[p_channel].muted.set();
-	} else {
-		channel_states[p_channel].muted.clear();
+void AudioStreamPlaybackMIDISF2::push_midi_messages(const PackedInt32Array &p_messages) {
+	ERR_FAIL_COND_MSG(p_messages.size() % 4 != 0, "Expected [type, channel, param1, param2] quadruples.");
+	const int32_t *r = p_messages.ptr();
+	int count = p_messages.size() / 4;
+
+	if (!threaded) {
+		live_input_used.set();
 	}
-	// silence channels that became non-audible
-	for (int i = 0; i < MIDI_CHANNEL_COUNT; i++) {
-		if (!_is_channel_audible(i)) {
-			push_midi_message(MESSAGE_CONTROL_CHANGE, i, CONTROLLER_ALL_NOTES_OFF, 0);
+	PENDING_MUTEX_LOCK
+	pending_messages.reserve(pending_messages.size() + count);
+	for (int i = 0; i < count; i++) {
+		const int32_t *m = r + i * 4;
+		if (m[1] < 0 || m[1] >= channel_count) {
+			continue;
 		}
+		pending_messages.push_back({ (MIDIMessageType)m[0], m[1], m[2], m[3] });
+	}
+	PENDING_MUTEX_UNLOCK
+}
+
+void AudioStreamPlaybackMIDISF2::push_midi_bytes(const PackedByteArray &p_bytes) {
+	if (!threaded) {
+		live_input_used.set();
 	}
+	PENDING_MUTEX_LOCK
+	MIDI::decode_raw_messages(p_bytes.ptr(), p_bytes.size(), [this](int p_type, int p_channel, int p_data1, int p_data2) {
+		if (p_type == MESSAGE_NOTE_ON && p_data2 == 0) {
+			p_type = MESSAGE_NOTE_OFF;
+		}
+		pending_messages.push_back({ (MIDIMessageType)p_type, p_channel, p_data1, p_data2 });
+	});
+	PENDING_MUTEX_UNLOCK
+}
+
+void AudioStreamPlaybackMIDISF2::set_channel_muted(int p_channel, bool p_muted) {
+	ERR_FAIL_INDEX(p_channel, channel_count);
+	PENDING_MUTEX_LOCK
+	channel_states[p_channel].muted.set_to(p_muted);
+	_update_audible_channels();
+	PENDING_MUTEX_UNLOCK
+	_update_channels_modified();
 }
 
 bool AudioStreamPlaybackMIDISF2::is_channel_muted(int p_channel) const {
-	ERR_FAIL_INDEX_V(p_channel, MIDI_CHANNEL_COUNT, false);
+	ERR_FAIL_INDEX_V(p_channel, channel_count, false);
 	return channel_states[p_channel].muted.is_set();
 }
 
 void AudioStreamPlaybackMIDISF2::set_channel_solo(int p_channel, bool p_solo) {
-	ERR_FAIL_INDEX(p_channel, MIDI_CHANNEL_COUNT);
-	if (p_solo) {
-		channel_states[p_channel].solo.set();
-	} else {
-		channel_states[p_channel].solo.clear();
-	}
-	// silence channels that became non-audible
-	for (int i = 0; i < MIDI_CHANNEL_COUNT; i++) {
-		if (!_is_channel_audible(i)) {
-			push_midi_message(MESSAGE_CONTROL_CHANGE, i, CONTROLLER_ALL_NOTES_OFF, 0);
-		}
-	}
+	ERR_FAIL_INDEX(p_channel, channel_count);
+	PENDING_MUTEX_LOCK
+	channel_states[p_channel].solo.set_to(p_solo);
+	_update_audible_channels();
+	PENDING_MUTEX_UNLOCK
+	_update_channels_modified();
 }
 
 bool AudioStreamPlaybackMIDISF2::is_channel_solo(int p_channel) const {
-	ERR_FAIL_INDEX_V(p_channel, MIDI_CHANNEL_COUNT, false);
+	ERR_FAIL_INDEX_V(p_channel, channel_count, false);
 	return channel_states[p_channel].solo.is_set();
 }
 
 void AudioStreamPlaybackMIDISF2::set_channel_transpose(int p_channel, int p_semitones) {
-	ERR_FAIL_INDEX(p_channel, MIDI_CHANNEL_COUNT);
+	ERR_FAIL_INDEX(p_channel, channel_count);
 	channel_states[p_channel].transpose.set(p_semitones);
+	_update_channels_modified();
 }
 
 int AudioStreamPlaybackMIDISF2::get_channel_transpose(int p_channel) const {
-	ERR_FAIL_INDEX_V(p_channel, MIDI_CHANNEL_COUNT, 0);
+	ERR_FAIL_INDEX_V(p_channel, channel_count, 0);
 	return channel_states[p_channel].transpose.get();
 }
 
 void AudioStreamPlaybackMIDISF2::set_channel_volume(int p_channel, float p_volume) {
-	ERR_FAIL_INDEX(p_channel, MIDI_CHANNEL_COUNT);
+	ERR_FAIL_INDEX(p_channel, channel_count);
 	channel_states[p_channel].volume.set(CLAMP(p_volume, 0.0f, 1.0f));
+	_update_channels_modified();
+}
+
+float AudioStreamPlaybackMIDISF2::get_channel_volume(int p_channel) const {
+	ERR_FAIL_INDEX_V(p_channel, channel_count, 1.0f);
+	return channel_states[p_channel].volume.get();
+}
+
+void AudioStreamPlaybackMIDISF2::fade_channel_gain(int p_channel, float p_gain, float p_seconds, bool p_suspend) {
+	ERR_FAIL_INDEX(p_channel, channel_count);
+	ERR_FAIL_COND(p_seconds < 0.0f);
+	ChannelState &cs = channel_states[p_channel];
+	// the rendering thread compares the gain, so it goes last
+	cs.gain_fade.set(p_seconds);
+	cs.gain_suspend.set_to(p_suspend);
+	cs.gain.set(CLAMP(p_gain, 0.0f, 1.0f));
+	channel_gains_changed.set();
+	_update_channels_modified();
+}
+
+float AudioStreamPlaybackMIDISF2::get_channel_gain(int p_channel) const {
+	ERR_FAIL_INDEX_V(p_channel, channel_count, 1.0f);
+	return channel_states[p_channel].gain.get();
+}
+
+void AudioStreamPlaybackMIDISF2::set_channel_program_override(int p_channel, int p_program) {
+	ERR_FAIL_INDEX(p_channel, channel_count);
+	channel_states[p_channel].program_override.set(p_program);
+	_update_channels_modified();
+}
+
+int AudioStreamPlaybackMIDISF2::get_channel_program_override(int p_channel) const {
+	ERR_FAIL_INDEX_V(p_channel, channel_count, -1);
+	return channel_states[p_channel].program_override.get();
+}
+
+void AudioStreamPlaybackMIDISF2::set_channel_group(int p_channel, int p_group) {
+	ERR_FAIL_INDEX(p_channel, channel_count);
+	ERR_FAIL_INDEX(p_group, MAX_CHANNEL_GROUPS);
+	channel_groups[p_channel].set(p_group);
+
+	bool any = false;
+	for (int i = 0; i < channel_count && !any; i++) {
+		any = channel_groups[i].get() != 0;
+	}
+	stems_active.set_to(any);
+	_update_channels_modified();
+}
+
+int AudioStreamPlaybackMIDISF2::get_channel_group(int p_channel) const {
+	ERR_FAIL_INDEX_V(p_channel, channel_count, 0);
+	return channel_groups[p_channel].get();
+}
+
+Ref<AudioStreamMIDIStem> AudioStreamPlaybackMIDISF2::get_stem_stream(int p_group) {
+	ERR_FAIL_COND_V_MSG(p_group < 1 || p_group >= MAX_CHANNEL_GROUPS, Ref<AudioStreamMIDIStem>(), "Group 0 is the main output, stems are groups 1 to 7.");
+	if (!stem_connected[p_group].is_set()) {
+		// allocated once, the audio thread only starts writing after the flag is set
+		stem_rings[p_group].resize(STEM_BUFFER_FRAMES);
+		stem_connected[p_group].set();
+	}
+
+	Ref<AudioStreamMIDIStem> stem;
+	stem.instantiate();
+	stem->source = Ref<AudioStreamPlaybackMIDISF2>(this);
+	stem->group = p_group;
+	return stem;
+}
+
+int AudioStreamPlaybackMIDISF2::read_stem(int p_group, AudioFrame *p_buffer, int p_frames) {
+	if (!stem_connected[p_group].is_set()) {
+		return 0;
+	}
+	return stem_rings[p_group].read(p_buffer, p_frames);
 }
 
-float AudioStreamPlaybackMIDISF2::get_channel_volume(int p_channel) const {
-	ERR_FAIL_INDEX_V(p_channel, MIDI_CHANNEL_COUNT, 1.0f);
-	return channel_states[p_channel].volume.get();
+void AudioStreamPlaybackMIDISF2::clear_stem(int p_group) {
+	if (stem_connected[p_group].is_set()) {
+		stem_rings[p_group].clear();
+	}
 }
 
-void AudioStreamPlaybackMIDISF2::set_channel_program_override(int p_channel, int p_program) {
-	ERR_FAIL_INDEX(p_channel, MIDI_CHANNEL_COUNT);
-	channel_states[p_channel].program_override.set(p_program);
+void AudioStreamPlaybackMIDISF2::set_stem_listening(int p_group, bool p_listening) {
+	ERR_FAIL_INDEX(p_group, MAX_CHANNEL_GROUPS);
+	if (p_listening) {
+		stem_listeners[p_group].increment();
+	} else {
+		stem_listeners[p_group].decrement();
+	}
 }
 
-int AudioStreamPlaybackMIDISF2::get_channel_program_override(int p_channel) const {
-	ERR_FAIL_INDEX_V(p_channel, MIDI_CHANNEL_COUNT, -1);
-	return channel_states[p_channel].program_override.get();
+void AudioStreamPlaybackMIDISF2::_write_stem(int p_group, const AudioFrame *p_frames, AudioFrame *p_main, int p_count) {
+	int written = stem_rings[p_group].write(p_frames, p_count);
+	// the stem stopped draining (a paused player, a stalled bus), what doesn't fit goes back to the main output
+	for (int i = written; i < p_count; i++) {
+		p_main[i].left += p_frames[i].left;
+		p_main[i].right += p_frames[i].right;
+	}
 }
 
 int AudioStreamPlaybackMIDISF2::get_channel_preset_index(int p_channel) const {
-	ERR_FAIL_INDEX_V(p_channel, MIDI_CHANNEL_COUNT, -1);
+	ERR_FAIL_INDEX_V(p_channel, channel_count, -1);
 	ERR_FAIL_COND_V(!tsf_instance, -1);
 	return tsf_channel_get_preset_index(tsf_instance, p_channel);
 }
 
 int AudioStreamPlaybackMIDISF2::get_channel_preset_number(int p_channel) const {
-	ERR_FAIL_INDEX_V(p_channel, MIDI_CHANNEL_COUNT, -1);
+	ERR_FAIL_INDEX_V(p_channel, channel_count, -1);
 	ERR_FAIL_COND_V(!tsf_instance, -1);
 	return tsf_channel_get_preset_number(tsf_instance, p_channel);
 }
 
 String AudioStreamPlaybackMIDISF2::get_channel_preset_name(int p_channel) const {
-	ERR_FAIL_INDEX_V(p_channel, MIDI_CHANNEL_COUNT, String());
+	ERR_FAIL_INDEX_V(p_channel, channel_count, String());
 	ERR_FAIL_COND_V(!tsf_instance, String());
 	int idx = tsf_channel_get_preset_index(tsf_instance, p_channel);
 	if (idx < 0) {
@@ -399,12 +1451,13 @@ TypedArray<Dictionary> AudioStreamPlaybackMIDISF2::get_midi_channel_list() const
 		int program = 0;
 		int note_count = 0;
 	};
-	ChannelInfo infos[MIDI_CHANNEL_COUNT] = {};
+	LocalVector<ChannelInfo> infos;
+	infos.resize(channel_count);
 
 	tml_message *msg = midi_stream->midi->get_midi();
 	while (msg) {
 		int ch = msg->channel;
-		if (ch >= 0 && ch < MIDI_CHANNEL_COUNT) {
+		if (ch >= 0 && ch < channel_count) {
 			if (msg->type == TML_PROGRAM_CHANGE) {
 				infos[ch].program = msg->program;
 				infos[ch].used = true;
@@ -416,18 +1469,19 @@ TypedArray<Dictionary> AudioStreamPlaybackMIDISF2::get_midi_channel_list() const
 		msg = msg->next;
 	}
 
-	for (int i = 0; i < MIDI_CHANNEL_COUNT; i++) {
+	for (int i = 0; i < channel_count; i++) {
 		if (!infos[i].used) {
 			continue;
 		}
 		Dictionary d;
 		d["channel"] = i;
+		d["port"] = i / 16;
 		d["program"] = infos[i].program;
 		d["note_count"] = infos[i].note_count;
-		d["is_drum"] = (i == 9);
+		d["is_drum"] = (i % 16 == 9);
 
 		if (tsf_instance) {
-			int bank = (i == 9) ? 128 : 0;
+			int bank = (i % 16 == 9) ? 128 : 0;
 			const char *name = tsf_bank_get_presetname(tsf_instance, bank, infos[i].program);
 			d["preset_name"] = name ? String::utf8(name) : String();
 		} else {
@@ -439,53 +1493,206 @@ TypedArray<Dictionary> AudioStreamPlaybackMIDISF2::get_midi_channel_list() const
 	return result;
 }
 
+bool AudioStreamPlaybackMIDISF2::is_using_prerender() const {
+	return using_prerender;
+}
+
+bool AudioStreamPlaybackMIDISF2::is_event_polling() const {
+	return event_polling;
+}
+
+PackedInt32Array AudioStreamPlaybackMIDISF2::poll_applied_midi_messages() {
+	PackedInt32Array result;
+	ERR_FAIL_COND_V_MSG(!event_polling, result, "Event polling is disabled, enable AudioStreamMIDI.event_polling before playing.");
+
+	uint32_t count = applied_messages.data_left();
+	if (count == 0) {
+		return result;
+	}
+	result.resize(count * 5);
+	int32_t *w = result.ptrw();
+	AppliedMIDIMessage msg;
+	uint32_t i = 0;
+	while (i < count && applied_messages.pop(msg)) {
+		w[i * 5 + 0] = msg.type;
+		w[i * 5 + 1] = msg.channel;
+		w[i * 5 + 2] = msg.param1;
+		w[i * 5 + 3] = msg.param2;
+		w[i * 5 + 4] = msg.time;
+		i++;
+	}
+	return result;
+}
+
+int AudioStreamPlaybackMIDISF2::get_dropped_message_count() const {
+	return dropped_message_count.get();
+}
+
+int AudioStreamPlaybackMIDISF2::get_underrun_count() const {
+	return underrun_count.get();
+}
+
+int AudioStreamPlaybackMIDISF2::get_culled_voice_count() const {
+	return culled_voice_count.get();
+}
+
+void AudioStreamPlaybackMIDISF2::start_recording(int p_capacity) {
+	recorder.start(p_capacity, mix_rate);
+}
+
+void AudioStreamPlaybackMIDISF2::stop_recording() {
+	recorder.stop();
+}
+
+bool AudioStreamPlaybackMIDISF2::is_recording() const {
+	return recorder.is_recording();
+}
+
+int AudioStreamPlaybackMIDISF2::get_recording_dropped_count() const {
+	return recorder.get_dropped_count();
+}
+
+Ref<MIDI> AudioStreamPlaybackMIDISF2::get_recorded_midi() {
+	return recorder.get_midi();
+}
+
+PackedByteArray AudioStreamPlaybackMIDISF2::get_recorded_smf() {
+	return recorder.get_smf();
+}
+
+void AudioStreamPlaybackMIDISF2::advance(double p_seconds) {
+	ERR_FAIL_COND_MSG(!events_only, "advance() is only available with AudioStreamMIDI.events_only.");
+	ERR_FAIL_COND(p_seconds < 0.0);
+	ERR_FAIL_COND_MSG(server_mixed.is_set(), "This playback is being mixed by the AudioServer, which already advances it. Start a playback from AudioStream.instantiate_playback() instead.");
+
+	// stands in for the mix of a playback nobody mixes, on the caller's thread
+	ADVANCE_MUTEX_LOCK
+	_snapshot_parameters();
+	_apply_song_commands();
+
+	double frames = p_seconds * mix_rate + advance_carry;
+	int64_t remaining = (int64_t)frames;
+	advance_carry = frames - remaining;
+
+	// the output is silent and skipped over between events, the buffer is never read
+	AudioFrame buffer[WORKER_CHUNK_FRAMES];
+	while (remaining > 0 && active.is_set()) {
+		int count = (int)MIN(remaining, (int64_t)WORKER_CHUNK_FRAMES);
+		_render(buffer, count);
+		remaining -= count;
+	}
+	ADVANCE_MUTEX_UNLOCK
+}
+
+void AudioStreamPlaybackMIDISF2::transition_to(const Ref<MIDI> &p_midi, TransitionSync p_sync, double p_fade_seconds, int p_beats_per_bar) {
+	ERR_FAIL_COND(p_midi.is_null() || !p_midi->get_midi());
+	ERR_FAIL_COND_MSG(p_midi->get_channel_count() > channel_count, "The MIDI uses more ports than the one this playback was instantiated with.");
+	ERR_FAIL_COND(p_fade_seconds < 0.0);
+	ERR_FAIL_COND(p_beats_per_bar < 1);
+
+	// cue sets are small, keeping every song until the playback goes away is cheap and never frees on the audio thread
+	if (song_refs.find(p_midi) < 0) {
+		song_refs.push_back(p_midi);
+	}
+
+	PENDING_MUTEX_LOCK
+	pending_transition.midi = p_midi.ptr();
+	pending_transition.sync = p_sync;
+	pending_transition.fade_seconds = p_fade_seconds;
+	pending_transition.beats_per_bar = p_beats_per_bar;
+	transition_active.set();
+	transition_requested.set();
+	PENDING_MUTEX_UNLOCK
+
+	if (threaded) {
+		_worker_post();
+	}
+}
+
+bool AudioStreamPlaybackMIDISF2::is_transition_pending() const {
+	return transition_active.is_set();
+}
+
+int AudioStreamPlaybackMIDISF2::get_audio_thread_allocation_count() const {
+	return audio_thread_guard_get_allocation_count();
+}
+
+void AudioStreamPlaybackMIDISF2::set_applied_message_filter(int p_filter) {
+	applied_message_filter.set(p_filter & APPLIED_MESSAGE_ALL);
+}
+
+int AudioStreamPlaybackMIDISF2::get_applied_message_filter() const {
+	return applied_message_filter.get();
+}
+
+void AudioStreamPlaybackMIDISF2::set_channel_applied_messages_enabled(int p_channel, bool p_enabled) {
+	ERR_FAIL_INDEX(p_channel, channel_count);
+	reported_channels.set(p_channel, p_enabled);
+}
+
+bool AudioStreamPlaybackMIDISF2::is_channel_applied_messages_enabled(int p_channel) const {
+	ERR_FAIL_INDEX_V(p_channel, channel_count, false);
+	return reported_channels.has(p_channel);
+}
+
 AudioStreamPlaybackMIDISF2::AudioStreamPlaybackMIDISF2() {
 #ifdef _GDEXTENSION
 	pending_mutex.instantiate();
+	advance_mutex.instantiate();
 #endif
-	for (int i = 0; i < MIDI_CHANNEL_COUNT; i++) {
-		channel_states[i].volume.set(1.0f);
-		channel_states[i].program_override.set(-1);
-	}
+	applied_message_filter.set(APPLIED_MESSAGE_ALL);
+	pending_messages.reserve(PENDING_FLUSH_CHUNK);
+	audible_channels.fill(true);
+	reported_channels.fill(true);
 }
 
 void AudioStreamPlaybackMIDISF2::_apply_pending_message(const PendingMIDIMessage &p_msg) {
-	if (!tsf_instance) {
+	recorder.record(record_clock, p_msg.type, p_msg.channel, p_msg.param1, p_msg.param2);
+
+	// in threaded mode the song synthesizer belongs to the worker
+	tsf *synth = threaded ? live_tsf : tsf_instance;
+	// nothing would ever render the voices they start
+	if (!synth || events_only) {
 		return;
 	}
 
 	int channel = p_msg.channel;
-	int transpose = midi_stream.is_valid() ? midi_stream->transpose : 0;
-	int ch_transpose = (channel >= 0 && channel < MIDI_CHANNEL_COUNT) ? channel_states[channel].transpose.get() : 0;
+	// in threaded mode params belong to the worker, read the stream directly
+	int transpose = midi_stream.is_valid() ? midi_stream->transpose.get() : 0;
+	int ch_transpose = (channel >= 0 && channel < channel_count) ? channel_states[channel].transpose.get() : 0;
 
 	switch (p_msg.type) {
 		case MESSAGE_PROGRAM_CHANGE : {
-			int override_prog = (channel >= 0 && channel < MIDI_CHANNEL_COUNT) ? channel_states[channel].program_override.get() : -1;
+			int override_prog = (channel >= 0 && channel < channel_count) ? channel_states[channel].program_override.get() : -1;
 			int actual_program = (override_prog >= 0) ? override_prog : p_msg.param1;
-			tsf_channel_set_presetnumber(tsf_instance, channel, actual_program, (channel == 9));
+			tsf_channel_set_presetnumber(synth, channel, actual_program, (channel % 16 == 9));
 		} break;
 		case MESSAGE_NOTE_ON : {
-			if (!_is_channel_audible(channel)) {
+			// the suspended channels belong to the worker in threaded mode, and live_tsf isn't faded
+			if (!audible_channels.has(channel) || (!threaded && _is_channel_suspended(channel))) {
 				break;
 			}
 			int key = p_msg.param1 + transpose * 12 + ch_transpose;
 			key = CLAMP(key, 0, 127);
 			float vel = p_msg.param2 / 127.0f;
-			if (channel >= 0 && channel < MIDI_CHANNEL_COUNT) {
+			if (channel >= 0 && channel < channel_count) {
 				vel *= channel_states[channel].volume.get();
 			}
-			tsf_channel_note_on(tsf_instance, channel, key, vel);
+			tsf_channel_note_on(synth, channel, key, vel);
 		} break;
 		case MESSAGE_NOTE_OFF : {
 			int key = p_msg.param1 + transpose * 12 + ch_transpose;
 			key = CLAMP(key, 0, 127);
-			tsf_channel_note_off(tsf_instance, channel, key);
+			tsf_channel_note_off(synth, channel, key);
 		} break;
 		case MESSAGE_PITCH_BEND : {
-			tsf_channel_set_pitchwheel(tsf_instance, channel, p_msg.param1);
+			tsf_channel_set_pitchwheel(synth, channel, p_msg.param1);
 		} break;
 		case MESSAGE_CONTROL_CHANGE : {
-			tsf_channel_midi_control(tsf_instance, channel, p_msg.param1, p_msg.param2);
+			tsf_channel_midi_control(synth, channel, p_msg.param1, p_msg.param2);
+			if (synth == tsf_instance) {
+				effects.control(channel, p_msg.param1, p_msg.param2);
+			}
 		} break;
 		default:
 			break;
@@ -493,18 +1700,33 @@ void AudioStreamPlaybackMIDISF2::_apply_pending_message(const PendingMIDIMessage
 }
 
 void AudioStreamPlaybackMIDISF2::_flush_pending_messages() {
-	PENDING_MUTEX_LOCK
-	LocalVector<PendingMIDIMessage> local_msgs(pending_messages);
-	pending_messages.clear();
-	PENDING_MUTEX_UNLOCK
+	while (true) {
+		PENDING_MUTEX_LOCK
+		uint32_t total = pending_messages.size();
+		uint32_t count = MIN(total, (uint32_t)PENDING_FLUSH_CHUNK);
+		for (uint32_t i = 0; i < count; i++) {
+			flush_buffer[i] = pending_messages[i];
+		}
+		for (uint32_t i = count; i < total; i++) {
+			pending_messages[i - count] = pending_messages[i];
+		}
+		// shrinking keeps the capacity
+		pending_messages.resize(total - count);
+		PENDING_MUTEX_UNLOCK
 
-	for (const PendingMIDIMessage &msg : local_msgs) {
-		_apply_pending_message(msg);
+		for (uint32_t i = 0; i < count; i++) {
+			_apply_pending_message(flush_buffer[i]);
+		}
+		if (count < (uint32_t)PENDING_FLUSH_CHUNK) {
+			break;
+		}
 	}
 }
 
 void AudioStreamPlaybackMIDISF2::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("push_midi_message", "type", "channel", "param1", "param2"), &AudioStreamPlaybackMIDISF2::push_midi_message, DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("push_midi_messages", "messages"), &AudioStreamPlaybackMIDISF2::push_midi_messages);
+	ClassDB::bind_method(D_METHOD("push_midi_bytes", "bytes"), &AudioStreamPlaybackMIDISF2::push_midi_bytes);
 
 	ClassDB::bind_method(D_METHOD("set_channel_muted", "channel", "muted"), &AudioStreamPlaybackMIDISF2::set_channel_muted);
 	ClassDB::bind_method(D_METHOD("is_channel_muted", "channel"), &AudioStreamPlaybackMIDISF2::is_channel_muted);
@@ -517,15 +1739,48 @@ void AudioStreamPlaybackMIDISF2::_bind_methods() {
 
 	ClassDB::bind_method(D_METHOD("set_channel_volume", "channel", "volume"), &AudioStreamPlaybackMIDISF2::set_channel_volume);
 	ClassDB::bind_method(D_METHOD("get_channel_volume", "channel"), &AudioStreamPlaybackMIDISF2::get_channel_volume);
+	ClassDB::bind_method(D_METHOD("fade_channel_gain", "channel", "gain", "seconds", "suspend"), &AudioStreamPlaybackMIDISF2::fade_channel_gain, DEFVAL(0.0), DEFVAL(true));
+	ClassDB::bind_method(D_METHOD("get_channel_gain", "channel"), &AudioStreamPlaybackMIDISF2::get_channel_gain);
 
 	ClassDB::bind_method(D_METHOD("set_channel_program_override", "channel", "program"), &AudioStreamPlaybackMIDISF2::set_channel_program_override);
 	ClassDB::bind_method(D_METHOD("get_channel_program_override", "channel"), &AudioStreamPlaybackMIDISF2::get_channel_program_override);
 
+	ClassDB::bind_method(D_METHOD("set_channel_group", "channel", "group"), &AudioStreamPlaybackMIDISF2::set_channel_group);
+	ClassDB::bind_method(D_METHOD("get_channel_group", "channel"), &AudioStreamPlaybackMIDISF2::get_channel_group);
+	ClassDB::bind_method(D_METHOD("get_stem_stream", "group"), &AudioStreamPlaybackMIDISF2::get_stem_stream);
+
 	ClassDB::bind_method(D_METHOD("get_channel_preset_index", "channel"), &AudioStreamPlaybackMIDISF2::get_channel_preset_index);
 	ClassDB::bind_method(D_METHOD("get_channel_preset_number", "channel"), &AudioStreamPlaybackMIDISF2::get_channel_preset_number);
 	ClassDB::bind_method(D_METHOD("get_channel_preset_name", "channel"), &AudioStreamPlaybackMIDISF2::get_channel_preset_name);
 	ClassDB::bind_method(D_METHOD("get_midi_channel_list"), &AudioStreamPlaybackMIDISF2::get_midi_channel_list);
 
+	ClassDB::bind_method(D_METHOD("is_using_prerender"), &AudioStreamPlaybackMIDISF2::is_using_prerender);
+
+	ClassDB::bind_method(D_METHOD("is_event_polling"), &AudioStreamPlaybackMIDISF2::is_event_polling);
+	ClassDB::bind_method(D_METHOD("poll_applied_midi_messages"), &AudioStreamPlaybackMIDISF2::poll_applied_midi_messages);
+	ClassDB::bind_method(D_METHOD("get_dropped_message_count"), &AudioStreamPlaybackMIDISF2::get_dropped_message_count);
+	ClassDB::bind_method(D_METHOD("get_audio_thread_allocation_count"), &AudioStreamPlaybackMIDISF2::get_audio_thread_allocation_count);
+	ClassDB::bind_method(D_METHOD("get_underrun_count"), &AudioStreamPlaybackMIDISF2::get_underrun_count);
+	ClassDB::bind_method(D_METHOD("get_culled_voice_count"), &AudioStreamPlaybackMIDISF2::get_culled_voice_count);
+
+	ClassDB::bind_method(D_METHOD("advance", "seconds"), &AudioStreamPlaybackMIDISF2::advance);
+
+	ClassDB::bind_method(D_METHOD("start_recording", "capacity"), &AudioStreamPlaybackMIDISF2::start_recording, DEFVAL(MIDIRecorder::DEFAULT_CAPACITY));
+	ClassDB::bind_method(D_METHOD("stop_recording"), &AudioStreamPlaybackMIDISF2::stop_recording);
+	ClassDB::bind_method(D_METHOD("is_recording"), &AudioStreamPlaybackMIDISF2::is_recording);
+	ClassDB::bind_method(D_METHOD("get_recording_dropped_count"), &AudioStreamPlaybackMIDISF2::get_recording_dropped_count);
+	ClassDB::bind_method(D_METHOD("get_recorded_midi"), &AudioStreamPlaybackMIDISF2::get_recorded_midi);
+	ClassDB::bind_method(D_METHOD("get_recorded_smf"), &AudioStreamPlaybackMIDISF2::get_recorded_smf);
+
+	ClassDB::bind_method(D_METHOD("transition_to", "midi", "sync", "fade_seconds", "beats_per_bar"), &AudioStreamPlaybackMIDISF2::transition_to, DEFVAL(TRANSITION_NEXT_BAR), DEFVAL(0.0), DEFVAL(4));
+	ClassDB::bind_method(D_METHOD("is_transition_pending"), &AudioStreamPlaybackMIDISF2::is_transition_pending);
+
+	ClassDB::bind_method(D_METHOD("set_applied_message_filter", "filter"), &AudioStreamPlaybackMIDISF2::set_applied_message_filter);
+	ClassDB::bind_method(D_METHOD("get_applied_message_filter"), &AudioStreamPlaybackMIDISF2::get_applied_message_filter);
+
+	ClassDB::bind_method(D_METHOD("set_channel_applied_messages_enabled", "channel", "enabled"), &AudioStreamPlaybackMIDISF2::set_channel_applied_messages_enabled);
+	ClassDB::bind_method(D_METHOD("is_channel_applied_messages_enabled", "channel"), &AudioStreamPlaybackMIDISF2::is_channel_applied_messages_enabled);
+
 	ADD_SIGNAL(MethodInfo("applied_midi_message",
 		PropertyInfo(Variant::INT, "type"),
 		PropertyInfo(Variant::INT, "channel"),
@@ -614,18 +1869,31 @@ void AudioStreamPlaybackMIDISF2::_bind_methods() {
 	BIND_ENUM_CONSTANT(CONTROLLER_OMNI_ON);
 	BIND_ENUM_CONSTANT(CONTROLLER_POLY_OFF);
 	BIND_ENUM_CONSTANT(CONTROLLER_POLY_ON);
+
+	BIND_ENUM_CONSTANT(APPLIED_MESSAGE_NOTE);
+	BIND_ENUM_CONSTANT(APPLIED_MESSAGE_CONTROL_CHANGE);
+	BIND_ENUM_CONSTANT(APPLIED_MESSAGE_PROGRAM_CHANGE);
+	BIND_ENUM_CONSTANT(APPLIED_MESSAGE_PITCH_BEND);
+	BIND_ENUM_CONSTANT(APPLIED_MESSAGE_SET_TEMPO);
+	BIND_ENUM_CONSTANT(APPLIED_MESSAGE_ALL);
+
+	BIND_ENUM_CONSTANT(TRANSITION_IMMEDIATE);
+	BIND_ENUM_CONSTANT(TRANSITION_NEXT_BEAT);
+	BIND_ENUM_CONSTANT(TRANSITION_NEXT_BAR);
+	BIND_ENUM_CONSTANT(TRANSITION_SONG_END);
 }
 
 AudioStreamMIDI::AudioStreamMIDI() {
-	tempo_scale = 1.0f;
-	transpose = 0;
 }
 
 AudioStreamMIDI::~AudioStreamMIDI() {
+	// running render and prerender tasks keep the stream referenced, so there's nothing to wait for here
+	_invalidate_prerender();
 }
 
 void AudioStreamMIDI::set_soundfont(const Ref<SoundFont2> &p_soundfont) {
 	soundfont = p_soundfont;
+	_invalidate_prerender();
 }
 
 Ref<SoundFont2> AudioStreamMIDI::get_soundfont() const {
@@ -634,6 +1902,7 @@ Ref<SoundFont2> AudioStreamMIDI::get_soundfont() const {
 
 void AudioStreamMIDI::set_midi(const Ref<MIDI> &p_midi) {
 	midi = p_midi;
+	_invalidate_prerender();
 }
 
 Ref<MIDI> AudioStreamMIDI::get_midi() const {
@@ -642,23 +1911,29 @@ Ref<MIDI> AudioStreamMIDI::get_midi() const {
 
 void AudioStreamMIDI::set_tempo_scale(float p_scale) {
 	ERR_FAIL_COND(p_scale <= 0.0f);
-	tempo_scale = p_scale;
+	if (tempo_scale.get() != p_scale) {
+		_invalidate_prerender();
+	}
+	tempo_scale.set(p_scale);
 }
 
 float AudioStreamMIDI::get_tempo_scale() const {
-	return tempo_scale;
+	return tempo_scale.get();
 }
 
 void AudioStreamMIDI::set_transpose(int p_shift) {
-	transpose = p_shift;
+	if (transpose.get() != p_shift) {
+		_invalidate_prerender();
+	}
+	transpose.set(p_shift);
 }
 
 int AudioStreamMIDI::get_transpose() const {
-	return transpose;
+	return transpose.get();
 }
 
 void AudioStreamMIDI::set_loop(bool p_enable) {
-	loop = p_enable;
+	loop.set_to(p_enable);
 }
 
 #ifdef _GDEXTENSION
@@ -666,19 +1941,53 @@ bool AudioStreamMIDI::_has_loop() const {
 #else
 bool AudioStreamMIDI::has_loop() const {
 #endif
-	return loop;
+	return loop.is_set();
 }
 
 void AudioStreamMIDI::set_loop_offset(double p_seconds) {
-	loop_offset = p_seconds;
+	loop_offset.set(p_seconds);
 }
 
 double AudioStreamMIDI::get_loop_offset() const {
-	return loop_offset;
+	return loop_offset.get();
 }
 
-#ifdef _GDEXTENSION
-Ref<AudioStreamPlayback> AudioStreamMIDI::_instantiate_playback() const {
+void AudioStreamMIDI::set_loop_start_beat(double p_beat) {
+	ERR_FAIL_COND(p_beat < 0.0);
+	loop_start_beat = p_beat;
+}
+
+double AudioStreamMIDI::get_loop_start_beat() const {
+	return loop_start_beat;
+}
+
+void AudioStreamMIDI::set_loop_end_beat(double p_beat) {
+	ERR_FAIL_COND(p_beat < 0.0);
+	loop_end_beat = p_beat;
+}
+
+double AudioStreamMIDI::get_loop_end_beat() const {
+	return loop_end_beat;
+}
+
+void AudioStreamMIDI::set_event_polling(bool p_enable) {
+	event_polling = p_enable;
+}
+
+bool AudioStreamMIDI::is_event_polling() const {
+	return event_polling;
+}
+
+void AudioStreamMIDI::set_event_buffer_size(int p_size) {
+	ERR_FAIL_COND(p_size < 1);
+	event_buffer_size = p_size;
+}
+
+int AudioStreamMIDI::get_event_buffer_size() const {
+	return event_buffer_size;
+}
+
+Ref<AudioStreamPlaybackMIDISF2> AudioStreamMIDI::_create_playback(float p_mix_rate) const {
 	ERR_FAIL_COND_V_MSG(soundfont.is_null(), nullptr, "No SoundFont2 assigned.");
 	ERR_FAIL_COND_V_MSG(midi.is_null(), nullptr, "No MIDI assigned.");
 	ERR_FAIL_COND_V_MSG(!soundfont->get_soundfont(), nullptr, "SoundFont2 has no loaded data.");
@@ -691,50 +2000,373 @@ Ref<AudioStreamPlayback> AudioStreamMIDI::_instantiate_playback() const {
 	playback->tsf_instance = tsf_copy(soundfont->get_soundfont());
 	ERR_FAIL_COND_V_MSG(!playback->tsf_instance, nullptr, "Failed to copy SoundFont instance.");
 
-	float sample_rate = AudioServer::get_singleton()->get_mix_rate();
-
-	tsf_set_output(playback->tsf_instance, TSF_STEREO_INTERLEAVED, (int)sample_rate, 0.0f);
+	playback->mix_rate = p_mix_rate;
+	playback->quality = quality;
+	playback->synth_rate = quality == QUALITY_LOW ? MIN(p_mix_rate, (float)TSF_EXT_LOW_QUALITY_SAMPLE_RATE) : p_mix_rate;
+	playback->upsampling = playback->synth_rate < p_mix_rate;
+	playback->upsampler.setup(playback->synth_rate, p_mix_rate);
+	tsf_set_output(playback->tsf_instance, TSF_STEREO_INTERLEAVED, (int)playback->synth_rate, 0.0f);
 	tsf_set_max_voices(playback->tsf_instance, 256);
+	playback->_set_channel_count(midi->get_channel_count());
+	playback->effects.setup(playback->synth_rate);
 
+	if (events_only) {
+		playback->events_only = true;
+		playback->synth_bypassed = true;
+	}
+
+	playback->song_refs.push_back(midi);
+	playback->song_midi = midi.ptr();
 	playback->first_msg = midi->get_midi();
 	playback->current_msg = midi->get_midi();
 	playback->playback_msec = 0.0;
 	playback->frames_mixed = 0;
-	playback->active = false;
-	playback->loops = 0;
+
+	// scans song_midi, which has to be set by now. the loop points are fixed for the
+	// playback's lifetime, finding the state at the loop start walks the song and allocates
+	if (loop_end_beat > loop_start_beat) {
+		playback->_setup_loop(midi->get_beat_time(loop_start_beat) * 1000.0, midi->get_beat_time(loop_end_beat) * 1000.0);
+	}
+	playback->_snapshot_parameters();
+	playback->resumable.set();
 
 	return playback;
 }
+
+#ifdef _GDEXTENSION
+Ref<AudioStreamPlayback> AudioStreamMIDI::_instantiate_playback() const {
 #else
 Ref<AudioStreamPlayback> AudioStreamMIDI::instantiate_playback() {
-	ERR_FAIL_COND_V_MSG(soundfont.is_null(), nullptr, "No SoundFont2 assigned.");
-	ERR_FAIL_COND_V_MSG(midi.is_null(), nullptr, "No MIDI assigned.");
-	ERR_FAIL_COND_V_MSG(!soundfont->get_soundfont(), nullptr, "SoundFont2 has no loaded data.");
-	ERR_FAIL_COND_V_MSG(!midi->get_midi(), nullptr, "MIDI has no loaded data.");
+#endif
+	Ref<AudioStreamPlaybackMIDISF2> playback = _create_playback(AudioServer::get_singleton()->get_mix_rate());
+	if (playback.is_null()) {
+		return playback;
+	}
 
-	Ref<AudioStreamPlaybackMIDISF2> playback;
-	playback.instantiate();
-	playback->midi_stream = Ref<AudioStreamMIDI>(this);
+	playback->event_polling = event_polling;
+	playback->applied_messages.resize(event_buffer_size);
+	playback->_connect_signal_dispatch();
 
-	playback->tsf_instance = tsf_copy(soundfont->get_soundfont());
-	ERR_FAIL_COND_V_MSG(!playback->tsf_instance, nullptr, "Failed to copy SoundFont instance.");
+	if (prerender && !events_only) {
+		AudioStreamMIDI *self = const_cast<AudioStreamMIDI *>(this);
+		self->_ensure_prerender();
+		playback->prerender_cache = MIDIPrerenderCache::reference(self->prerender_cache);
+	}
 
-	float sample_rate = AudioServer::get_singleton()->get_mix_rate();
+	if (threaded_rendering && !events_only) {
+		tsf *live_tsf = tsf_copy(soundfont->get_soundfont());
+		ERR_FAIL_NULL_V_MSG(live_tsf, nullptr, "Failed to copy SoundFont instance.");
+		tsf_set_output(live_tsf, TSF_STEREO_INTERLEAVED, (int)playback->mix_rate, 0.0f);
+		tsf_set_max_voices(live_tsf, 64);
+		tsf_ext_reserve_channels(live_tsf, playback->channel_count);
+		playback->_start_worker(lookahead_msec, live_tsf);
+	}
 
-	tsf_set_output(playback->tsf_instance, TSF_STEREO_INTERLEAVED, (int)sample_rate, 0.0f);
-	tsf_set_max_voices(playback->tsf_instance, 256);
+	return playback;
+}
 
-	playback->first_msg = midi->get_midi();
-	playback->current_msg = midi->get_midi();
-	playback->playback_msec = 0.0;
-	playback->frames_mixed = 0;
-	playback->active = false;
-	playback->loops = 0;
+void AudioStreamMIDI::_ensure_prerender() {
+	float mix_rate = AudioServer::get_singleton()->get_mix_rate();
+	if (prerender_cache && prerender_cache->mix_rate != mix_rate) {
+		_invalidate_prerender();
+	}
+	// a task still busy with an outdated cache has to finish first, playbacks run live meanwhile
+	if (prerender_cache || prerender_task_id >= 0) {
+		return;
+	}
+	double seconds = _get_song_length() / tempo_scale.get() + RENDER_MAX_TAIL_SECONDS;
+	if (seconds > prerender_max_seconds) {
+		return;
+	}
 
-	return playback;
+	prerender_playback = _create_playback(mix_rate);
+	ERR_FAIL_COND(prerender_playback.is_null());
+	prerender_playback->loop_allowed = false;
+	prerender_playback->event_polling = true;
+	prerender_playback->set_applied_message_filter(0);
+#ifdef _GDEXTENSION
+	prerender_playback->_start(0.0);
+#else
+	prerender_playback->start(0.0);
+#endif
+
+	// allocated here once, the worker only fills it
+	MIDIPrerenderCache *cache = memnew(MIDIPrerenderCache);
+	cache->samples.resize((uint32_t)(seconds * mix_rate) * 2);
+	cache->mix_rate = mix_rate;
+	cache->tempo_scale = tempo_scale.get();
+
+	prerender_cache = cache;
+	prerender_task_cache = MIDIPrerenderCache::reference(cache);
+	prerender_task_id = WorkerThreadPool::get_singleton()->add_task(callable_mp(this, &AudioStreamMIDI::_prerender_task), false, "AudioStreamMIDI prerender");
+}
+
+void AudioStreamMIDI::_invalidate_prerender() {
+	if (!prerender_cache) {
+		return;
+	}
+	// playbacks holding it fall back to live synthesis, the memory goes with the last of them
+	prerender_cache->invalid.set();
+	MIDIPrerenderCache::release(prerender_cache);
+	prerender_cache = nullptr;
+}
+
+void AudioStreamMIDI::_prerender_task() {
+	MIDIPrerenderCache *cache = prerender_task_cache;
+	AudioStreamPlaybackMIDISF2 *playback = prerender_playback.ptr();
+
+	AudioFrame buffer[PRERENDER_CHUNK_FRAMES];
+	int16_t *dst = cache->samples.ptr();
+	uint32_t capacity = cache->samples.size() / 2;
+	uint32_t written = 0;
+
+	while (written < capacity && !cache->invalid.is_set()) {
+		int count = (int)MIN((uint32_t)PRERENDER_CHUNK_FRAMES, capacity - written);
+#ifdef _GDEXTENSION
+		playback->_mix(buffer, 1.0f, count);
+#else
+		playback->mix(buffer, 1.0f, count);
+#endif
+		for (int i = 0; i < count; i++) {
+			dst[(written + i) * 2] = (int16_t)CLAMP(buffer[i].left * 32767.0f, -32768.0f, 32767.0f);
+			dst[(written + i) * 2 + 1] = (int16_t)CLAMP(buffer[i].right * 32767.0f, -32768.0f, 32767.0f);
+		}
+		written += count;
+		cache->frames_ready.set(written);
+
+		if (!playback->active.is_set()) {
+			// drop the silence mixed after the song ended so loops stay tight
+			written = MIN(written, playback->frames_mixed);
+			break;
+		}
+	}
+
+	cache->frame_count.set(written);
+	cache->complete.set();
+
+	callable_mp(this, &AudioStreamMIDI::_prerender_done).call_deferred();
+}
+
+void AudioStreamMIDI::_prerender_done() {
+	WorkerThreadPool::get_singleton()->wait_for_task_completion(prerender_task_id);
+	prerender_task_id = -1;
+	MIDIPrerenderCache::release(prerender_task_cache);
+	prerender_task_cache = nullptr;
+
+	// the playback may hold the last reference to this stream, release it last
+	Ref<AudioStreamPlaybackMIDISF2> playback = prerender_playback;
+	prerender_playback.unref();
+}
+
+void AudioStreamMIDI::_render_task() {
+	AudioStreamPlaybackMIDISF2 *playback = render_playback.ptr();
+
+	double end = render_to >= 0.0 ? render_to : _get_song_length();
+	int64_t expected = MAX((int64_t)((end - render_from) / tempo_scale.get() * render_mix_rate), (int64_t)1);
+	// rendering to the end keeps going until the last notes have been released
+	int64_t max_frames = render_to >= 0.0 ? expected : expected + (int64_t)(RENDER_MAX_TAIL_SECONDS * render_mix_rate);
+
+	LocalVector<AudioFrame> frames;
+	frames.reserve(expected);
+
+	int64_t written = 0;
+	while (written < max_frames && !render_cancelled.is_set()) {
+		int count = (int)MIN((int64_t)RENDER_CHUNK_FRAMES, max_frames - written);
+		frames.resize(written + count);
+#ifdef _GDEXTENSION
+		playback->_mix(&frames[written], 1.0f, count);
+#else
+		playback->mix(&frames[written], 1.0f, count);
+#endif
+		written += count;
+		render_progress.set(MIN((float)written / expected, 1.0f));
+
+		if (render_to < 0.0 && !playback->active.is_set()) {
+			break;
+		}
+	}
+
+	rendered_frames.resize(written);
+	Vector2 *w = rendered_frames.ptrw();
+	for (int64_t i = 0; i < written; i++) {
+		w[i] = Vector2(frames[i].left, frames[i].right);
+	}
+
+	callable_mp(this, &AudioStreamMIDI::_render_done).call_deferred();
+}
+
+void AudioStreamMIDI::_render_done() {
+	WorkerThreadPool::get_singleton()->wait_for_task_completion(render_task_id);
+	render_task_id = -1;
+	// the playback may hold the last reference to this stream, release it last
+	Ref<AudioStreamPlaybackMIDISF2> playback = render_playback;
+	render_playback.unref();
+
+	bool cancelled = render_cancelled.is_set();
+	if (cancelled) {
+		rendered_frames.clear();
+	} else {
+		render_progress.set(1.0f);
+	}
+	emit_signal(SNAME("render_finished"), cancelled);
+}
+
+void AudioStreamMIDI::set_threaded_rendering(bool p_enable) {
+	threaded_rendering = p_enable;
+}
+
+bool AudioStreamMIDI::is_threaded_rendering() const {
+	return threaded_rendering;
+}
+
+void AudioStreamMIDI::set_events_only(bool p_enable) {
+	events_only = p_enable;
+}
+
+bool AudioStreamMIDI::is_events_only() const {
+	return events_only;
+}
+
+void AudioStreamMIDI::set_lookahead_msec(float p_msec) {
+	ERR_FAIL_COND(p_msec < 0.0f);
+	lookahead_msec = p_msec;
 }
+
+float AudioStreamMIDI::get_lookahead_msec() const {
+	return lookahead_msec;
+}
+
+void AudioStreamMIDI::set_prerender(bool p_enable) {
+	prerender = p_enable;
+	if (!prerender) {
+		_invalidate_prerender();
+	}
+}
+
+bool AudioStreamMIDI::is_prerender() const {
+	return prerender;
+}
+
+void AudioStreamMIDI::set_prerender_max_seconds(float p_seconds) {
+	ERR_FAIL_COND(p_seconds < 0.0f);
+	prerender_max_seconds = p_seconds;
+	// a cache already made for a longer song is kept, the limit applies to the next one
+}
+
+float AudioStreamMIDI::get_prerender_max_seconds() const {
+	return prerender_max_seconds;
+}
+
+void AudioStreamMIDI::set_quality(Quality p_quality) {
+	ERR_FAIL_INDEX((int)p_quality, QUALITY_HIGH + 1);
+	quality = p_quality;
+	_invalidate_prerender();
+}
+
+AudioStreamMIDI::Quality AudioStreamMIDI::get_quality() const {
+	return quality;
+}
+
+void AudioStreamMIDI::set_voice_cull_threshold_db(float p_db) {
+	voice_cull_threshold_db = p_db;
+	voice_cull_gain.set(Math::db_to_linear(p_db));
+	_invalidate_prerender();
+}
+
+float AudioStreamMIDI::get_voice_cull_threshold_db() const {
+	return voice_cull_threshold_db;
+}
+
+void AudioStreamMIDI::set_effects_enabled(bool p_enable) {
+	effects_enabled.set_to(p_enable);
+	_invalidate_prerender();
+}
+
+bool AudioStreamMIDI::is_effects_enabled() const {
+	return effects_enabled.is_set();
+}
+
+void AudioStreamMIDI::set_chase_notes(bool p_enable) {
+	chase_notes.set_to(p_enable);
+}
+
+bool AudioStreamMIDI::is_chase_notes() const {
+	return chase_notes.is_set();
+}
+
+Error AudioStreamMIDI::render(double p_from, double p_to, int p_mix_rate) {
+	ERR_FAIL_COND_V_MSG(is_rendering(), ERR_BUSY, "A render is already in progress.");
+	ERR_FAIL_COND_V(p_from < 0.0, ERR_INVALID_PARAMETER);
+	ERR_FAIL_COND_V(p_to >= 0.0 && p_to <= p_from, ERR_INVALID_PARAMETER);
+
+	render_mix_rate = p_mix_rate > 0 ? p_mix_rate : (int)AudioServer::get_singleton()->get_mix_rate();
+	render_playback = _create_playback(render_mix_rate);
+	ERR_FAIL_COND_V(render_playback.is_null(), ERR_UNCONFIGURED);
+
+	// a dedicated playback, live ones are never touched
+	render_playback->loop_allowed = false;
+	render_playback->event_polling = true;
+	render_playback->set_applied_message_filter(0);
+#ifdef _GDEXTENSION
+	render_playback->_start(p_from);
+#else
+	render_playback->start(p_from);
 #endif
 
+	render_from = p_from;
+	render_to = p_to;
+	render_cancelled.clear();
+	render_progress.set(0.0f);
+	rendered_frames.clear();
+
+	render_task_id = WorkerThreadPool::get_singleton()->add_task(callable_mp(this, &AudioStreamMIDI::_render_task), false, "AudioStreamMIDI render");
+	return OK;
+}
+
+bool AudioStreamMIDI::is_rendering() const {
+	return render_task_id >= 0;
+}
+
+float AudioStreamMIDI::get_render_progress() const {
+	return render_progress.get();
+}
+
+void AudioStreamMIDI::cancel_render() {
+	render_cancelled.set();
+}
+
+PackedVector2Array AudioStreamMIDI::get_rendered_frames() const {
+	ERR_FAIL_COND_V_MSG(is_rendering(), PackedVector2Array(), "Render still in progress.");
+	return rendered_frames;
+}
+
+Ref<AudioStreamWAV> AudioStreamMIDI::get_rendered_wav() const {
+	ERR_FAIL_COND_V_MSG(is_rendering(), Ref<AudioStreamWAV>(), "Render still in progress.");
+	ERR_FAIL_COND_V_MSG(rendered_frames.is_empty(), Ref<AudioStreamWAV>(), "Nothing has been rendered.");
+
+	int64_t count = rendered_frames.size();
+	PackedByteArray data;
+	data.resize(count * 4);
+	uint8_t *w = data.ptrw();
+	const Vector2 *r = rendered_frames.ptr();
+	for (int64_t i = 0; i < count; i++) {
+		int16_t l = (int16_t)CLAMP(r[i].x * 32767.0f, -32768.0f, 32767.0f);
+		int16_t rr = (int16_t)CLAMP(r[i].y * 32767.0f, -32768.0f, 32767.0f);
+		w[i * 4 + 0] = l & 0xFF;
+		w[i * 4 + 1] = (l >> 8) & 0xFF;
+		w[i * 4 + 2] = rr & 0xFF;
+		w[i * 4 + 3] = (rr >> 8) & 0xFF;
+	}
+
+	Ref<AudioStreamWAV> wav;
+	wav.instantiate();
+	wav->set_format(AudioStreamWAV::FORMAT_16_BITS);
+	wav->set_stereo(true);
+	wav->set_mix_rate(render_mix_rate);
+	wav->set_data(data);
+	return wav;
+}
+
 #ifdef _GDEXTENSION
 String AudioStreamMIDI::_get_stream_name() const {
 #else
@@ -748,6 +2380,10 @@ double AudioStreamMIDI::_get_length() const {
 #else
 double AudioStreamMIDI::get_length() const {
 #endif
+	return _get_song_length();
+}
+
+double AudioStreamMIDI::_get_song_length() const {
 	if (midi.is_null() || !midi->get_midi()) {
 		return 0.0;
 	}
@@ -787,10 +2423,74 @@ void AudioStreamMIDI::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_loop_offset", "seconds"), &AudioStreamMIDI::set_loop_offset);
 	ClassDB::bind_method(D_METHOD("get_loop_offset"), &AudioStreamMIDI::get_loop_offset);
 
+	ClassDB::bind_method(D_METHOD("set_loop_start_beat", "beat"), &AudioStreamMIDI::set_loop_start_beat);
+	ClassDB::bind_method(D_METHOD("get_loop_start_beat"), &AudioStreamMIDI::get_loop_start_beat);
+
+	ClassDB::bind_method(D_METHOD("set_loop_end_beat", "beat"), &AudioStreamMIDI::set_loop_end_beat);
+	ClassDB::bind_method(D_METHOD("get_loop_end_beat"), &AudioStreamMIDI::get_loop_end_beat);
+
+	ClassDB::bind_method(D_METHOD("set_event_polling", "enable"), &AudioStreamMIDI::set_event_polling);
+	ClassDB::bind_method(D_METHOD("is_event_polling"), &AudioStreamMIDI::is_event_polling);
+
+	ClassDB::bind_method(D_METHOD("set_event_buffer_size", "size"), &AudioStreamMIDI::set_event_buffer_size);
+	ClassDB::bind_method(D_METHOD("get_event_buffer_size"), &AudioStreamMIDI::get_event_buffer_size);
+
+	ClassDB::bind_method(D_METHOD("set_threaded_rendering", "enable"), &AudioStreamMIDI::set_threaded_rendering);
+	ClassDB::bind_method(D_METHOD("is_threaded_rendering"), &AudioStreamMIDI::is_threaded_rendering);
+
+	ClassDB::bind_method(D_METHOD("set_events_only", "enable"), &AudioStreamMIDI::set_events_only);
+	ClassDB::bind_method(D_METHOD("is_events_only"), &AudioStreamMIDI::is_events_only);
+
+	ClassDB::bind_method(D_METHOD("set_lookahead_msec", "msec"), &AudioStreamMIDI::set_lookahead_msec);
+	ClassDB::bind_method(D_METHOD("get_lookahead_msec"), &AudioStreamMIDI::get_lookahead_msec);
+
+	ClassDB::bind_method(D_METHOD("set_prerender", "enable"), &AudioStreamMIDI::set_prerender);
+	ClassDB::bind_method(D_METHOD("is_prerender"), &AudioStreamMIDI::is_prerender);
+	ClassDB::bind_method(D_METHOD("set_prerender_max_seconds", "seconds"), &AudioStreamMIDI::set_prerender_max_seconds);
+	ClassDB::bind_method(D_METHOD("get_prerender_max_seconds"), &AudioStreamMIDI::get_prerender_max_seconds);
+
+	ClassDB::bind_method(D_METHOD("set_effects_enabled", "enable"), &AudioStreamMIDI::set_effects_enabled);
+	ClassDB::bind_method(D_METHOD("is_effects_enabled"), &AudioStreamMIDI::is_effects_enabled);
+
+	ClassDB::bind_method(D_METHOD("set_chase_notes", "enable"), &AudioStreamMIDI::set_chase_notes);
+	ClassDB::bind_method(D_METHOD("is_chase_notes"), &AudioStreamMIDI::is_chase_notes);
+
+	ClassDB::bind_method(D_METHOD("set_quality", "quality"), &AudioStreamMIDI::set_quality);
+	ClassDB::bind_method(D_METHOD("get_quality"), &AudioStreamMIDI::get_quality);
+
+	ClassDB::bind_method(D_METHOD("set_voice_cull_threshold_db", "db"), &AudioStreamMIDI::set_voice_cull_threshold_db);
+	ClassDB::bind_method(D_METHOD("get_voice_cull_threshold_db"), &AudioStreamMIDI::get_voice_cull_threshold_db);
+
+	ClassDB::bind_method(D_METHOD("render", "from", "to", "mix_rate"), &AudioStreamMIDI::render, DEFVAL(0.0), DEFVAL(-1.0), DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("is_rendering"), &AudioStreamMIDI::is_rendering);
+	ClassDB::bind_method(D_METHOD("get_render_progress"), &AudioStreamMIDI::get_render_progress);
+	ClassDB::bind_method(D_METHOD("cancel_render"), &AudioStreamMIDI::cancel_render);
+	ClassDB::bind_method(D_METHOD("get_rendered_frames"), &AudioStreamMIDI::get_rendered_frames);
+	ClassDB::bind_method(D_METHOD("get_rendered_wav"), &AudioStreamMIDI::get_rendered_wav);
+
+	ADD_SIGNAL(MethodInfo("render_finished", PropertyInfo(Variant::BOOL, "cancelled")));
+
+	BIND_ENUM_CONSTANT(QUALITY_LOW);
+	BIND_ENUM_CONSTANT(QUALITY_NORMAL);
+	BIND_ENUM_CONSTANT(QUALITY_HIGH);
+
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "soundfont", PROPERTY_HINT_RESOURCE_TYPE, "SoundFont2"), "set_soundfont", "get_soundfont");
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "midi", PROPERTY_HINT_RESOURCE_TYPE, "MIDI"), "set_midi", "get_midi");
 	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "tempo_scale", PROPERTY_HINT_RANGE, "0.01,10.0,0.01"), "set_tempo_scale", "get_tempo_scale");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "transpose", PROPERTY_HINT_RANGE, "-10,10,1"), "set_transpose", "get_transpose");
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "loop"), "set_loop", "has_loop");
 	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "loop_offset"), "set_loop_offset", "get_loop_offset");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "loop_start_beat", PROPERTY_HINT_RANGE, "0,10000,0.001,or_greater"), "set_loop_start_beat", "get_loop_start_beat");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "loop_end_beat", PROPERTY_HINT_RANGE, "0,10000,0.001,or_greater"), "set_loop_end_beat", "get_loop_end_beat");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "chase_notes"), "set_chase_notes", "is_chase_notes");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "event_polling"), "set_event_polling", "is_event_polling");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "event_buffer_size", PROPERTY_HINT_RANGE, "64,65536,1,or_greater"), "set_event_buffer_size", "get_event_buffer_size");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "quality", PROPERTY_HINT_ENUM, "Low,Normal,High"), "set_quality", "get_quality");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "voice_cull_threshold_db", PROPERTY_HINT_RANGE, "-144,0,0.1,suffix:dB"), "set_voice_cull_threshold_db", "get_voice_cull_threshold_db");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "effects_enabled"), "set_effects_enabled", "is_effects_enabled");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "prerender"), "set_prerender", "is_prerender");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "prerender_max_seconds", PROPERTY_HINT_RANGE, "0,3600,1,or_greater,suffix:s"), "set_prerender_max_seconds", "get_prerender_max_seconds");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "threaded_rendering"), "set_threaded_rendering", "is_threaded_rendering");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "events_only"), "set_events_only", "is_events_only");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "lookahead_msec", PROPERTY_HINT_RANGE, "0,1000,1,suffix:ms"), "set_lookahead_msec", "get_lookahead_msec");
 }
\ No newline at end of file
@@ -4,14 +4,20 @@
 #include <godot_cpp/classes/audio_server.hpp>
 #include <godot_cpp/classes/audio_stream.hpp>
 #include <godot_cpp/classes/audio_stream_playback.hpp>
+#include <godot_cpp/classes/audio_stream_wav.hpp>
 #include <godot_cpp/classes/mutex.hpp>
+#include <godot_cpp/classes/semaphore.hpp>
+#include <godot_cpp/classes/thread.hpp>
 #include <godot_cpp/templates/local_vector.hpp>
 #include <godot_cpp/templates/safe_refcount.hpp>
 using namespace godot;
 #else
 #include "servers/audio/audio_server.h"
 #include "servers/audio/audio_stream.h"
+#include "scene/resources/audio_stream_wav.h"
 #include "core/os/mutex.h"
+#include "core/os/semaphore.h"
+#include "core/os/thread.h"
 #include "core/templates/local_vector.h"
 #include "core/templates/safe_refcount.h"
 #endif
@@ -20,8 +26,40 @@ using namespace godot;
 
 #include "soundfont2.h"
 #include "midi.h"
+#include "lock_free_ring_buffer.h"
+#include "channel_mask.h"
+#include "linear_upsampler.h"
+#include "midi_effects.h"
+#include "midi_recorder.h"
 
 class AudioStreamMIDI;
+class AudioStreamMIDIStem;
+
+// PCM of the whole song rendered ahead of time, shared by the playbacks of one stream.
+// the buffer is sized before rendering starts and never reallocated, frames below
+// frames_ready can be read from any thread while the worker appends more
+struct MIDIPrerenderCache {
+	SafeRefCount refcount;
+	LocalVector<int16_t> samples; // stereo interleaved
+	SafeNumeric<uint32_t> frames_ready;
+	SafeNumeric<uint32_t> frame_count; // set once complete
+	SafeFlag complete;
+	SafeFlag invalid;
+	float mix_rate = 0.0f;
+	float tempo_scale = 1.0f;
+
+	static MIDIPrerenderCache *reference(MIDIPrerenderCache *p_cache) {
+		if (p_cache) {
+			p_cache->refcount.ref();
+		}
+		return p_cache;
+	}
+	static void release(MIDIPrerenderCache *p_cache) {
+		if (p_cache && p_cache->refcount.unref()) {
+			memdelete(p_cache);
+		}
+	}
+};
 
 class AudioStreamPlaybackMIDISF2 : public AudioStreamPlayback {
 	GDCLASS(AudioStreamPlaybackMIDISF2, AudioStreamPlayback);
@@ -113,19 +151,145 @@ public:
 		CONTROLLER_POLY_ON = 127,
 	};
 
+	enum AppliedMessageFilter {
+		APPLIED_MESSAGE_NOTE = 1,
+		APPLIED_MESSAGE_CONTROL_CHANGE = 2,
+		APPLIED_MESSAGE_PROGRAM_CHANGE = 4,
+		APPLIED_MESSAGE_PITCH_BEND = 8,
+		APPLIED_MESSAGE_SET_TEMPO = 16,
+		APPLIED_MESSAGE_ALL = 31,
+	};
+
+	enum TransitionSync {
+		TRANSITION_IMMEDIATE,
+		TRANSITION_NEXT_BEAT,
+		TRANSITION_NEXT_BAR,
+		TRANSITION_SONG_END,
+	};
+
 private:
 	friend class AudioStreamMIDI;
 
 	Ref<AudioStreamMIDI> midi_stream;
 
 	tsf *tsf_instance = nullptr;
+	// every MIDI the playback was given, kept alive here so the rendering thread never frees one.
+	// main thread only, the rendering thread uses song_midi
+	LocalVector<Ref<MIDI>> song_refs;
+	const MIDI *song_midi = nullptr; // the song being played, provides the note index and tempo map
 	tml_message *first_msg = nullptr;
 	tml_message *current_msg = nullptr;
-	double playback_msec = 0.0;
+	double playback_msec = 0.0; // owned by the thread rendering the song
+	SafeNumeric<double> reported_msec; // playback_msec as of the last rendered block, for the main thread
 	uint32_t frames_mixed = 0;
-	bool active = false;
+	float mix_rate = 44100.0f;
+	SafeFlag active; // only written by the thread rendering the song, see play_request
 	bool suppress_signals = false;
-	int loops = 0;
+	bool loop_allowed = true; // offline renders always stop at the end
+	SafeNumeric<int> loops;
+
+	// start, seek and stop only post these, the thread rendering the song applies them
+	// before its next block, so the synthesizer and the song cursor have a single owner
+	SafeFlag stop_requested;
+	SafeFlag seek_requested;
+	SafeFlag restart_requested; // the seek comes from start(), loop count starts over
+	SafeNumeric<double> seek_target_msec;
+	// (sequence << 1) | playing, posted by start and stop. active follows the latest one, so a start
+	// posted while the song runs out is applied after the end instead of being cleared by it
+	SafeNumeric<uint32_t> play_request;
+	SafeNumeric<uint32_t> applied_play_request;
+	// the song state matches get_playback_position(): set on creation and by seeks, cleared by stop
+	// and the song's end. a start at that position resumes instead of seeking
+	SafeFlag resumable;
+	static constexpr double RESUME_TOLERANCE_MSEC = 0.5;
+
+	bool _can_resume_at(double p_time) const;
+	void _request_play_state(bool p_playing);
+
+	// stream properties the song rendering reads, copied once per mix so a block never
+	// sees half of an update. owned by the thread rendering the song
+	struct StreamParameters {
+		float tempo_scale = 1.0f;
+		int transpose = 0;
+		bool loop = false;
+		double loop_offset_msec = 0.0;
+		bool effects_enabled = true;
+		bool chase_notes = true;
+		float voice_cull_gain = 0.0f;
+	};
+	StreamParameters params;
+
+	void _snapshot_parameters();
+	// returns whether a seek was applied
+	bool _apply_song_commands();
+
+	// prerendered playback, falls back to the synthesizer whenever the cache can't be used
+	static const int PRERENDER_MIN_LEAD_FRAMES = 8192;
+	MIDIPrerenderCache *prerender_cache = nullptr;
+	uint32_t prerender_frame = 0;
+	bool using_prerender = false;
+	bool synth_bypassed = false; // events are reported but not sent to tsf
+	// no synthesis at all: the song cursor only drives the applied messages, the output is silent
+	bool events_only = false;
+	double advance_carry = 0.0; // fraction of a frame left over by advance()
+	// advance() and an events_only mix both render the song, the lock keeps them apart.
+	// server_mixed is set by every events_only mix and cleared by stop, advance() refuses while it's set
+#ifdef _GDEXTENSION
+	Ref<Mutex> advance_mutex;
+#else
+	BinaryMutex advance_mutex;
+#endif
+	SafeFlag server_mixed;
+	SafeFlag channels_modified;
+	// pushed messages went to tsf_instance since the last seek, loop or stop. never set in threaded
+	// mode, where live input plays on live_tsf and the song synthesizer stays as cached
+	SafeFlag live_input_used;
+
+	// gapless loop between two beats: wrapped inside the render block at the exact frame,
+	// notes held across the end are released and ring on, the synthesizer is never reset
+	bool gapless_loop = false;
+	double loop_start_msec = 0.0;
+	double loop_end_msec = 0.0;
+	tml_message *loop_start_msg = nullptr;
+	LocalVector<tml_message *> loop_state; // the last program, pitch bend and controllers before loop_start_msec
+
+	void _setup_loop(double p_start_msec, double p_end_msec);
+	void _wrap_loop();
+	void _release_held_notes();
+
+	// transition_to() hands the request over under pending_mutex, the rendering thread
+	// schedules it against its own position and switches songs on the exact frame
+	struct TransitionRequest {
+		const MIDI *midi = nullptr;
+		TransitionSync sync = TRANSITION_NEXT_BAR;
+		double fade_seconds = 0.0;
+		int beats_per_bar = 4;
+	};
+	TransitionRequest pending_transition;
+	SafeFlag transition_requested;
+	SafeFlag transition_active; // requested or scheduled, for the main thread
+	TransitionRequest transition; // owned by the rendering thread from here on
+	bool transition_scheduled = false;
+	double transition_msec = 0.0; // in the outgoing song's time
+	double transition_fade_msec = 0.0;
+	bool song_replaced = false; // the prerender cache holds another song
+
+	void _schedule_transition();
+	void _update_transition_msec();
+	void _apply_transition();
+	void _apply_transition_fade(AudioFrame *p_buffer, int p_frames, double p_start_msec);
+	// the next loop end or transition, DBL_MAX without either
+	double _get_boundary_msec(bool p_use_loop) const;
+	void _cross_boundary();
+
+	bool _can_use_prerender(int p_frames) const;
+	void _update_prerender_state(int p_frames);
+	void _update_channels_modified();
+	void _copy_prerendered(AudioFrame *p_buffer, int p_frames);
+	int _get_idle_frames(int p_frames, float p_tempo_scale, double p_end_msec) const;
+	void _seek_to_msec(double p_msec);
+	// p_offset_sec > 0 starts the note as if it had been playing for that long
+	void _start_note(const tml_message *p_msg, double p_offset_sec);
 
 	struct PendingMIDIMessage {
 		MIDIMessageType type;
@@ -134,19 +298,148 @@ private:
 		int param2;
 	};
 
-	static const int MIDI_CHANNEL_COUNT = 16;
+	// 16 channels per port, tml_message::channel is a byte
+	static const int MAX_CHANNEL_COUNT = 256;
 
-	struct ChannelState {
-		SafeFlag muted;
-		SafeFlag solo;
+	// everything event dispatch reads for a channel, packed so it shares one cache line
+	struct alignas(16) ChannelState {
 		SafeNumeric<int> transpose; // semitones
-		SafeNumeric<float> volume; // 0.0 - 1.0, multiplier
-		SafeNumeric<int> program_override; // -1 = no override
+		SafeNumeric<float> volume{ 1.0f }; // 0.0 - 1.0, multiplier
+		SafeNumeric<int> program_override{ -1 }; // -1 = no override
+		SafeFlag muted; // main thread only, folded into audible_channels
+		SafeFlag solo; // main thread only, folded into audible_channels
+		// render-time gain the channel ramps to, over gain_fade seconds
+		SafeNumeric<float> gain{ 1.0f };
+		SafeNumeric<float> gain_fade;
+		SafeFlag gain_suspend{ true }; // free the voices once silent
+	};
+
+	// sized to the channels the MIDI file actually uses when the playback is instantiated, ports are
+	// packed densely by MIDI so unused ports cost nothing. allocated up front rather than on first
+	// touch: a state is 32 bytes, no smaller than a pointer table that would let the audio thread
+	// see it appear, and this way every lookup stays a bounds check and one indexed load
+	int channel_count = 0;
+	LocalVector<ChannelState> channel_states;
+
+	// derived from mute/solo whenever they change, the audio thread never scans flags
+	ChannelMask<MAX_CHANNEL_COUNT> audible_channels;
+	ChannelMask<MAX_CHANNEL_COUNT> reported_channels;
+
+	// song notes currently on, by original key. audio thread only
+	uint64_t held_notes[MAX_CHANNEL_COUNT][2] = {};
+
+	void _set_channel_count(int p_count);
+	void _update_audible_channels();
+
+	// channel gains, applied per sample to the rendered voices so layers fade without retriggering.
+	// owned by whichever thread renders the song, fade_channel_gain() only sets targets.
+	// a channel that reached 0 with gain_suspend is suspended: its voices are freed and its
+	// notes skipped, and the notes it would be holding are chased when it fades back in
+	static constexpr float MIN_GAIN_FADE_SECONDS = 0.005f;
+	SafeFlag channel_gains_changed;
+	bool channel_gains_active = false; // some channel isn't at unity or is fading, cleared once all are back at 1
+	bool channel_gains_ramping = false; // some channel hasn't reached its target, the idle skip waits for it
+	float channel_gains[MAX_CHANNEL_COUNT];
+	float channel_gain_targets[MAX_CHANNEL_COUNT];
+	float channel_gain_steps[MAX_CHANNEL_COUNT]; // per synth frame
+	float channel_gain_from[MAX_CHANNEL_COUNT]; // ramp of the block being rendered
+	uint64_t suspended_channels[MAX_CHANNEL_COUNT / 64] = {};
+	uint64_t suspending_channels[MAX_CHANNEL_COUNT / 64] = {}; // reached 0 in the block being rendered
+
+	void _update_channel_gains();
+	// moves the gains p_frames synth frames on, channel_gain_from and channel_gains hold the ramp
+	void _advance_channel_gains(int p_frames);
+	void _free_suspended_voices();
+	bool _is_channel_suspended(int p_channel) const {
+		return (suspended_channels[p_channel >> 6] >> (p_channel & 63)) & 1;
+	}
+
+	static const int MIX_BLOCK_SIZE = 64;
+
+	// stems: channels assigned to a group other than 0 are rendered into that group's
+	// ring, which an AudioStreamMIDIStem playback drains on its own bus.
+	// groups whose stem isn't playing stay in the main output, and so does whatever a full ring drops
+	static const int MAX_CHANNEL_GROUPS = 8;
+	static const int STEM_BUFFER_FRAMES = 8192;
+	SafeNumeric<uint8_t> channel_groups[MAX_CHANNEL_COUNT];
+	uint8_t render_groups[MAX_CHANNEL_COUNT] = {}; // audio thread, channel_groups with silent stems mapped to 0
+	SafeFlag stems_active;
+	SafeFlag stem_connected[MAX_CHANNEL_GROUPS]; // ring allocated
+	SafeNumeric<uint32_t> stem_listeners[MAX_CHANNEL_GROUPS]; // stem playbacks currently playing
+	LockFreeRingBuffer<AudioFrame> stem_rings[MAX_CHANNEL_GROUPS];
+	float stem_block[MAX_CHANNEL_GROUPS][MIX_BLOCK_SIZE * 2];
+
+	bool _is_stem_listened(int p_group) const {
+		return stem_connected[p_group].is_set() && stem_listeners[p_group].get() > 0;
+	}
+	void _write_stem(int p_group, const AudioFrame *p_frames, AudioFrame *p_main, int p_count);
+
+	// reverb and chorus sends (CC91 / CC93), owned by whichever thread renders the song
+	MIDIEffects effects;
+
+	// render quality, a tsf_ext_quality. below the mix rate, tsf_instance renders at
+	// synth_rate into synth_block and the result is upsampled
+	int quality = 1; // TSF_EXT_QUALITY_NORMAL
+	float synth_rate = 44100.0f;
+	bool upsampling = false;
+	LinearUpsampler upsampler;
+	LinearUpsampler::State upsample_states[MAX_CHANNEL_GROUPS];
+	AudioFrame synth_block[MIX_BLOCK_SIZE];
+	AudioFrame stem_upsampled[MIX_BLOCK_SIZE];
+
+	// one mix block of song output at the mix rate: stems, effects and upsampling
+	void _synthesize(AudioFrame *p_buffer, int p_frames, bool p_stems, bool p_effects);
+	// renders p_frames at synth_rate into p_buffer and stem_block
+	void _render_voices(AudioFrame *p_buffer, int p_frames, bool p_stems, bool p_effects);
+
+	// threaded rendering: a worker renders the song into render_ring ahead of the audio thread,
+	// live input is played by live_tsf directly in mix so it doesn't wait for the lookahead
+	static const int WORKER_CHUNK_FRAMES = 256;
+	static const int MIRROR_BUFFER_SIZE = 1024;
+
+	struct MirroredMessage {
+		MIDIMessageType type;
+		int channel;
+		int param1;
+		int param2;
+		uint32_t frame; // render_ring position it takes effect at
 	};
 
-	ChannelState channel_states[MIDI_CHANNEL_COUNT];
-	bool _has_any_solo() const;
-	bool _is_channel_audible(int p_channel) const;
+	bool threaded = false;
+	tsf *live_tsf = nullptr;
+	LockFreeRingBuffer<AudioFrame> render_ring;
+	LockFreeRingBuffer<MirroredMessage> mirror_messages; // channel state for live_tsf
+	MirroredMessage mirror_next = {};
+	bool has_mirror_next = false;
+	uint32_t mirror_frame = 0;
+	uint32_t worker_lookahead_frames = 0;
+	uint64_t worker_audible_words[ChannelMask<MAX_CHANNEL_COUNT>::WORD_COUNT] = {};
+	SafeFlag worker_exit;
+	SafeNumeric<uint32_t> worker_seek_marker;
+	SafeNumeric<uint32_t> worker_seek_sequence;
+	uint32_t consumed_seek_sequence = 0;
+	SafeNumeric<uint32_t> underrun_count;
+	SafeNumeric<uint32_t> culled_voice_count;
+#ifdef _GDEXTENSION
+	Ref<Thread> worker_thread;
+	Ref<Semaphore> worker_semaphore;
+#else
+	Thread worker_thread;
+	Semaphore worker_semaphore;
+	static void _worker_thread_func(void *p_userdata);
+#endif
+
+	void _start_worker(float p_lookahead_msec, tsf *p_live_tsf);
+	void _stop_worker();
+	void _worker_loop();
+	void _worker_post();
+	void _worker_wait();
+	void _sync_worker_audible_channels();
+	void _mix_threaded(AudioFrame *p_buffer, int p_frames);
+	void _mirror_message(MIDIMessageType p_type, int p_channel, int p_param1, int p_param2);
+	void _apply_mirrored_messages(uint32_t p_up_to_frame);
+	void _forward_applied_messages(uint32_t p_from_frame, uint32_t p_up_to_frame);
+	void _render(AudioFrame *p_buffer, int p_frames);
 
 #ifdef _GDEXTENSION
 	Ref<Mutex> pending_mutex;
@@ -155,6 +448,44 @@ private:
 #endif
 	LocalVector<PendingMIDIMessage> pending_messages;
 
+	// audio thread side copy of pending_messages, taken in fixed-size chunks so flushing never allocates
+	static const int PENDING_FLUSH_CHUNK = 256;
+	PendingMIDIMessage flush_buffer[PENDING_FLUSH_CHUNK];
+
+	// applied messages reported back to the main thread when event polling is enabled
+	struct AppliedMIDIMessage {
+		int type;
+		int channel;
+		int param1;
+		int param2;
+		int time; // msec
+	};
+
+	// the ring is used for the signal path too, it's drained on the main thread once per frame
+	bool event_polling = false;
+	bool signal_dispatch_connected = false;
+	LockFreeRingBuffer<AppliedMIDIMessage> applied_messages;
+	SafeNumeric<uint32_t> dropped_message_count;
+
+	// threaded mode: the worker reports messages a lookahead early, the audio thread holds them
+	// here and forwards them to applied_messages once their frame is played
+	struct HeldAppliedMessage {
+		AppliedMIDIMessage message;
+		uint32_t frame; // render_ring position
+	};
+	LockFreeRingBuffer<HeldAppliedMessage> held_messages;
+	HeldAppliedMessage held_next = {};
+	bool has_held_next = false;
+	SafeNumeric<int> applied_message_filter;
+
+	void _report_applied_message(tml_message *p_msg, int p_param1, int p_param2);
+	void _connect_signal_dispatch();
+	void _emit_applied_messages();
+
+	// pushed messages are logged as they were pushed, before transpose and overrides
+	MIDIRecorder recorder;
+	uint64_t record_clock = 0; // frames mixed, audio thread only
+
 	void _flush_pending_messages();
 	void _apply_pending_message(const PendingMIDIMessage &p_msg);
 	void _process_midi_events(double p_up_to_msec);
@@ -189,6 +520,8 @@ public:
 #endif
 
 	void push_midi_message(MIDIMessageType p_type, int p_channel, int p_param1, int p_param2 = 0);
+	void push_midi_messages(const PackedInt32Array &p_messages);
+	void push_midi_bytes(const PackedByteArray &p_bytes);
 
 	void set_channel_muted(int p_channel, bool p_muted);
 	bool is_channel_muted(int p_channel) const;
@@ -202,20 +535,61 @@ public:
 	void set_channel_volume(int p_channel, float p_volume);
 	float get_channel_volume(int p_channel) const;
 
+	void fade_channel_gain(int p_channel, float p_gain, float p_seconds = 0.0f, bool p_suspend = true);
+	float get_channel_gain(int p_channel) const;
+
 	void set_channel_program_override(int p_channel, int p_program);
 	int get_channel_program_override(int p_channel) const;
 
+	void set_channel_group(int p_channel, int p_group);
+	int get_channel_group(int p_channel) const;
+	Ref<AudioStreamMIDIStem> get_stem_stream(int p_group);
+
+	// used by AudioStreamPlaybackMIDIStem
+	int read_stem(int p_group, AudioFrame *p_buffer, int p_frames);
+	void clear_stem(int p_group);
+	void set_stem_listening(int p_group, bool p_listening);
+
 	int get_channel_preset_index(int p_channel) const;
 	int get_channel_preset_number(int p_channel) const;
 	String get_channel_preset_name(int p_channel) const;
 	TypedArray<Dictionary> get_midi_channel_list() const;
 
+	bool is_using_prerender() const;
+
+	bool is_event_polling() const;
+	PackedInt32Array poll_applied_midi_messages();
+	int get_dropped_message_count() const;
+	int get_audio_thread_allocation_count() const;
+	int get_underrun_count() const;
+	int get_culled_voice_count() const;
+
+	void advance(double p_seconds);
+
+	void start_recording(int p_capacity = MIDIRecorder::DEFAULT_CAPACITY);
+	void stop_recording();
+	bool is_recording() const;
+	int get_recording_dropped_count() const;
+	Ref<MIDI> get_recorded_midi();
+	PackedByteArray get_recorded_smf();
+
+	void transition_to(const Ref<MIDI> &p_midi, TransitionSync p_sync = TRANSITION_NEXT_BAR, double p_fade_seconds = 0.0, int p_beats_per_bar = 4);
+	bool is_transition_pending() const;
+
+	void set_applied_message_filter(int p_filter);
+	int get_applied_message_filter() const;
+
+	void set_channel_applied_messages_enabled(int p_channel, bool p_enabled);
+	bool is_channel_applied_messages_enabled(int p_channel) const;
+
 	AudioStreamPlaybackMIDISF2();
 	~AudioStreamPlaybackMIDISF2();
 };
 
 VARIANT_ENUM_CAST(AudioStreamPlaybackMIDISF2::MIDIMessageType);
 VARIANT_ENUM_CAST(AudioStreamPlaybackMIDISF2::MIDIController);
+VARIANT_ENUM_CAST(AudioStreamPlaybackMIDISF2::AppliedMessageFilter);
+VARIANT_ENUM_CAST(AudioStreamPlaybackMIDISF2::TransitionSync);
 
 class AudioStreamMIDI : public AudioStream {
 	GDCLASS(AudioStreamMIDI, AudioStream);
@@ -223,13 +597,71 @@ class AudioStreamMIDI : public AudioStream {
 	OBJ_SAVE_TYPE(AudioStream);
 #endif
 
+public:
+	// same values as tsf_ext_quality
+	enum Quality {
+		QUALITY_LOW,
+		QUALITY_NORMAL,
+		QUALITY_HIGH,
+	};
+
+private:
 	Ref<SoundFont2> soundfont;
 	Ref<MIDI> midi;
 
-	float tempo_scale = 1.0f;
-	int transpose = 0;
-	bool loop = false;
-	double loop_offset = 0.0;
+	// read by the audio thread, see AudioStreamPlaybackMIDISF2::StreamParameters
+	SafeNumeric<float> tempo_scale{ 1.0f };
+	SafeNumeric<int> transpose;
+	SafeFlag loop;
+	SafeNumeric<double> loop_offset;
+	// read when a playback is instantiated, not by the audio thread
+	double loop_start_beat = 0.0;
+	double loop_end_beat = 0.0;
+	bool event_polling = false;
+	int event_buffer_size = 4096;
+
+	// offline rendering runs a dedicated playback on a WorkerThreadPool task
+	static const int RENDER_CHUNK_FRAMES = 4096;
+	static constexpr double RENDER_MAX_TAIL_SECONDS = 10.0;
+	static const int PRERENDER_CHUNK_FRAMES = 1024;
+
+	Ref<AudioStreamPlaybackMIDISF2> render_playback;
+	int64_t render_task_id = -1;
+	double render_from = 0.0;
+	double render_to = -1.0;
+	int render_mix_rate = 44100;
+	SafeFlag render_cancelled;
+	SafeNumeric<float> render_progress;
+	PackedVector2Array rendered_frames;
+
+	bool threaded_rendering = false;
+	float lookahead_msec = 100.0f;
+
+	bool events_only = false;
+
+	SafeFlag effects_enabled{ true };
+	SafeFlag chase_notes{ true };
+	Quality quality = QUALITY_NORMAL;
+	float voice_cull_threshold_db = -80.0f;
+	SafeNumeric<float> voice_cull_gain{ 0.0001f }; // linear voice_cull_threshold_db, read by the audio thread
+
+	bool prerender = false;
+	// longer songs play live, the cache is 4 bytes per frame and allocated in full up front
+	float prerender_max_seconds = 300.0f;
+	MIDIPrerenderCache *prerender_cache = nullptr;
+	MIDIPrerenderCache *prerender_task_cache = nullptr;
+	Ref<AudioStreamPlaybackMIDISF2> prerender_playback;
+	int64_t prerender_task_id = -1;
+
+	void _ensure_prerender();
+	void _invalidate_prerender();
+	void _prerender_task();
+	void _prerender_done();
+
+	Ref<AudioStreamPlaybackMIDISF2> _create_playback(float p_mix_rate) const;
+	double _get_song_length() const;
+	void _render_task();
+	void _render_done();
 
 	friend class AudioStreamPlaybackMIDISF2;
 
@@ -259,6 +691,52 @@ public:
 	void set_loop_offset(double p_seconds);
 	double get_loop_offset() const;
 
+	void set_loop_start_beat(double p_beat);
+	double get_loop_start_beat() const;
+
+	void set_loop_end_beat(double p_beat);
+	double get_loop_end_beat() const;
+
+	void set_event_polling(bool p_enable);
+	bool is_event_polling() const;
+
+	void set_event_buffer_size(int p_size);
+	int get_event_buffer_size() const;
+
+	void set_threaded_rendering(bool p_enable);
+	bool is_threaded_rendering() const;
+
+	void set_events_only(bool p_enable);
+	bool is_events_only() const;
+
+	void set_lookahead_msec(float p_msec);
+	float get_lookahead_msec() const;
+
+	void set_prerender(bool p_enable);
+	bool is_prerender() const;
+
+	void set_prerender_max_seconds(float p_seconds);
+	float get_prerender_max_seconds() const;
+
+	void set_effects_enabled(bool p_enable);
+	bool is_effects_enabled() const;
+
+	void set_chase_notes(bool p_enable);
+	bool is_chase_notes() const;
+
+	void set_quality(Quality p_quality);
+	Quality get_quality() const;
+
+	void set_voice_cull_threshold_db(float p_db);
+	float get_voice_cull_threshold_db() const;
+
+	Error render(double p_from = 0.0, double p_to = -1.0, int p_mix_rate = 0);
+	bool is_rendering() const;
+	float get_render_progress() const;
+	void cancel_render();
+	PackedVector2Array get_rendered_frames() const;
+	Ref<AudioStreamWAV> get_rendered_wav() const;
+
 #ifdef _GDEXTENSION
 	virtual Ref<AudioStreamPlayback> _instantiate_playback() const override;
 	virtual String _get_stream_name() const override;
@@ -273,4 +751,6 @@ public:
 
 	AudioStreamMIDI();
 	~AudioStreamMIDI();
-};
\ No newline at end of file
+};
+
+VARIANT_ENUM_CAST(AudioStreamMIDI::Quality);
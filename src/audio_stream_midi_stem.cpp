@@ -0,0 +1,143 @@
+#include "audio_stream_midi_stem.h"
+
+#ifdef _GDEXTENSION
+#include <godot_cpp/classes/audio_server.hpp>
+using namespace godot;
+#else
+#include "core/object/class_db.h"
+#include "servers/audio/audio_server.h"
+#endif
+
+#ifdef _GDEXTENSION
+void AudioStreamPlaybackMIDIStem::_start(double p_from_pos) {
+#else
+void AudioStreamPlaybackMIDIStem::start(double p_from_pos) {
+#endif
+	// whatever piled up while nobody was listening is stale
+	source->clear_stem(group);
+	position = 0.0;
+	if (!active) {
+		// from now on the group is taken out of the source's main output
+		source->set_stem_listening(group, true);
+		active = true;
+	}
+}
+
+#ifdef _GDEXTENSION
+void AudioStreamPlaybackMIDIStem::_stop() {
+#else
+void AudioStreamPlaybackMIDIStem::stop() {
+#endif
+	if (active) {
+		source->set_stem_listening(group, false);
+		active = false;
+	}
+}
+
+#ifdef _GDEXTENSION
+bool AudioStreamPlaybackMIDIStem::_is_playing() const {
+#else
+bool AudioStreamPlaybackMIDIStem::is_playing() const {
+#endif
+	return active;
+}
+
+#ifdef _GDEXTENSION
+int32_t AudioStreamPlaybackMIDIStem::_get_loop_count() const {
+#else
+int AudioStreamPlaybackMIDIStem::get_loop_count() const {
+#endif
+	return 0;
+}
+
+#ifdef _GDEXTENSION
+double AudioStreamPlaybackMIDIStem::_get_playback_position() const {
+#else
+double AudioStreamPlaybackMIDIStem::get_playback_position() const {
+#endif
+	return position;
+}
+
+#ifdef _GDEXTENSION
+void AudioStreamPlaybackMIDIStem::_seek(double p_time) {
+#else
+void AudioStreamPlaybackMIDIStem::seek(double p_time) {
+#endif
+	// follows the source playback, seek that one instead
+}
+
+#ifdef _GDEXTENSION
+int32_t AudioStreamPlaybackMIDIStem::_mix(AudioFrame *p_buffer, float p_rate_scale, int32_t p_frames) {
+#else
+int AudioStreamPlaybackMIDIStem::mix(AudioFrame *p_buffer, float p_rate_scale, int p_frames) {
+#endif
+	int count = active ? source->read_stem(group, p_buffer, p_frames) : 0;
+	for (int i = count; i < p_frames; i++) {
+		p_buffer[i].left = 0.0f;
+		p_buffer[i].right = 0.0f;
+	}
+	position += p_frames / mix_rate;
+	return p_frames;
+}
+
+void AudioStreamPlaybackMIDIStem::_bind_methods() {
+}
+
+AudioStreamPlaybackMIDIStem::~AudioStreamPlaybackMIDIStem() {
+	if (active) {
+		source->set_stem_listening(group, false);
+	}
+}
+
+Ref<AudioStreamPlaybackMIDISF2> AudioStreamMIDIStem::get_source() const {
+	return source;
+}
+
+int AudioStreamMIDIStem::get_group() const {
+	return group;
+}
+
+#ifdef _GDEXTENSION
+Ref<AudioStreamPlayback> AudioStreamMIDIStem::_instantiate_playback() const {
+#else
+Ref<AudioStreamPlayback> AudioStreamMIDIStem::instantiate_playback() {
+#endif
+	ERR_FAIL_COND_V_MSG(source.is_null(), nullptr, "Stem streams are created by AudioStreamPlaybackMIDISF2.get_stem_stream().");
+
+	Ref<AudioStreamPlaybackMIDIStem> playback;
+	playback.instantiate();
+	playback->source = source;
+	playback->group = group;
+	playback->mix_rate = AudioServer::get_singleton()->get_mix_rate();
+	return playback;
+}
+
+#ifdef _GDEXTENSION
+String AudioStreamMIDIStem::_get_stream_name() const {
+#else
+String AudioStreamMIDIStem::get_stream_name() const {
+#endif
+	return "";
+}
+
+#ifdef _GDEXTENSION
+double AudioStreamMIDIStem::_get_length() const {
+#else
+double AudioStreamMIDIStem::get_length() const {
+#endif
+	return 0.0;
+}
+
+#ifdef _GDEXTENSION
+bool AudioStreamMIDIStem::_is_monophonic() const {
+#else
+bool AudioStreamMIDIStem::is_monophonic() const {
+#endif
+	// every playback reads from the same buffer
+	return true;
+}
+
+void AudioStreamMIDIStem::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_source"), &AudioStreamMIDIStem::get_source);
+	ClassDB::bind_method(D_METHOD("get_group"), &AudioStreamMIDIStem::get_group);
+}
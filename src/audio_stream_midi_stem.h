@@ -0,0 +1,82 @@
+#pragma once
+
+#ifdef _GDEXTENSION
+#include <godot_cpp/classes/audio_stream.hpp>
+#include <godot_cpp/classes/audio_stream_playback.hpp>
+using namespace godot;
+#else
+#include "servers/audio/audio_stream.h"
+#endif
+
+#include "audio_stream_midi.h"
+
+class AudioStreamMIDIStem;
+
+class AudioStreamPlaybackMIDIStem : public AudioStreamPlayback {
+	GDCLASS(AudioStreamPlaybackMIDIStem, AudioStreamPlayback);
+
+	friend class AudioStreamMIDIStem;
+
+	Ref<AudioStreamPlaybackMIDISF2> source;
+	int group = 0;
+	bool active = false;
+	double position = 0.0;
+	float mix_rate = 44100.0f;
+
+protected:
+	static void _bind_methods();
+
+public:
+#ifdef _GDEXTENSION
+	virtual void _start(double p_from_pos = 0.0) override;
+	virtual void _stop() override;
+	virtual bool _is_playing() const override;
+
+	virtual int32_t _get_loop_count() const override;
+	virtual double _get_playback_position() const override;
+	virtual void _seek(double p_time) override;
+
+	virtual int32_t _mix(AudioFrame *p_buffer, float p_rate_scale, int32_t p_frames) override;
+#else
+	virtual void start(double p_from_pos = 0.0) override;
+	virtual void stop() override;
+	virtual bool is_playing() const override;
+
+	virtual int get_loop_count() const override;
+	virtual double get_playback_position() const override;
+	virtual void seek(double p_time) override;
+
+	virtual int mix(AudioFrame *p_buffer, float p_rate_scale, int p_frames) override;
+#endif
+
+	~AudioStreamPlaybackMIDIStem();
+};
+
+// one channel group of a playing AudioStreamPlaybackMIDISF2, see AudioStreamPlaybackMIDISF2::get_stem_stream
+class AudioStreamMIDIStem : public AudioStream {
+	GDCLASS(AudioStreamMIDIStem, AudioStream);
+
+	friend class AudioStreamPlaybackMIDISF2;
+
+	Ref<AudioStreamPlaybackMIDISF2> source;
+	int group = 0;
+
+protected:
+	static void _bind_methods();
+
+public:
+	Ref<AudioStreamPlaybackMIDISF2> get_source() const;
+	int get_group() const;
+
+#ifdef _GDEXTENSION
+	virtual Ref<AudioStreamPlayback> _instantiate_playback() const override;
+	virtual String _get_stream_name() const override;
+	virtual double _get_length() const override;
+	virtual bool _is_monophonic() const override;
+#else
+	virtual Ref<AudioStreamPlayback> instantiate_playback() override;
+	virtual String get_stream_name() const override;
+	virtual double get_length() const override;
+	virtual bool is_monophonic() const override;
+#endif
+};
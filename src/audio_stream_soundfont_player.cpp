@@ -7,6 +7,11 @@ using namespace godot;
 #include "core/object/class_db.h"
 #endif
 
+#include "audio_thread_guard.h"
+#include "denormal_guard.h"
+#include "midi.h"
+#include "tsf_ext.h"
+
 #include "../thirdparty/tinysoundfont/tsf.h"
 
 #ifdef _GDEXTENSION
@@ -18,45 +23,118 @@ using namespace godot;
 #endif
 
 void AudioStreamPlaybackSoundfont::_flush_pending_commands() {
-	PENDING_MUTEX_LOCK
-	LocalVector<PendingCommand> local_cmds(pending_commands);
-	pending_commands.clear();
-	PENDING_MUTEX_UNLOCK
-
 	if (!tsf_instance) {
 		return;
 	}
 
-	for (const PendingCommand &cmd : local_cmds) {
-		switch (cmd.type) {
-			case CMD_NOTE_ON : {
-				int key = CLAMP(cmd.param1, 0, 127);
-				float vel = CLAMP(cmd.fparam, 0.0f, 1.0f);
-				tsf_channel_note_on(tsf_instance, cmd.channel, key, vel);
-			} break;
-			case CMD_NOTE_OFF : {
-				int key = CLAMP(cmd.param1, 0, 127);
-				tsf_channel_note_off(tsf_instance, cmd.channel, key);
-			} break;
-			case CMD_NOTE_OFF_ALL : {
-				tsf_note_off_all(tsf_instance);
-			} break;
-			case CMD_SET_PRESET : {
-				bool drums = (cmd.param2 != 0);
-				tsf_channel_set_presetnumber(tsf_instance, cmd.channel, cmd.param1, drums);
-			} break;
-			case CMD_CONTROL_CHANGE : {
-				tsf_channel_midi_control(tsf_instance, cmd.channel, cmd.param1, cmd.param2);
-			} break;
-			case CMD_PITCH_BEND : {
-				tsf_channel_set_pitchwheel(tsf_instance, cmd.channel, cmd.param1);
-			} break;
-			case CMD_CHANNEL_PRESSURE : {
-				tsf_channel_midi_control(tsf_instance, cmd.channel, 0x07 /* volume MSB */, cmd.param1);
-			} break;
-			default:
-				break;
+	while (true) {
+		PENDING_MUTEX_LOCK
+		uint32_t total = pending_commands.size();
+		uint32_t count = MIN(total, (uint32_t)PENDING_FLUSH_CHUNK);
+		for (uint32_t i = 0; i < count; i++) {
+			flush_buffer[i] = pending_commands[i];
+		}
+		for (uint32_t i = count; i < total; i++) {
+			pending_commands[i - count] = pending_commands[i];
 		}
+		// shrinking keeps the capacity
+		pending_commands.resize(total - count);
+		PENDING_MUTEX_UNLOCK
+
+		for (uint32_t i = 0; i < count; i++) {
+			_apply_command(flush_buffer[i]);
+		}
+		if (count < (uint32_t)PENDING_FLUSH_CHUNK) {
+			break;
+		}
+	}
+}
+
+void AudioStreamPlaybackSoundfont::_apply_command(const PendingCommand &p_cmd) {
+	used_channel_count = MAX(used_channel_count, p_cmd.channel + 1);
+	switch (p_cmd.type) {
+		case CMD_NOTE_ON : {
+			int key = CLAMP(p_cmd.param1, 0, 127);
+			float vel = CLAMP(p_cmd.fparam, 0.0f, 1.0f);
+			// a velocity that rounds to 0 would read as a note off
+			int velocity = vel > 0.0f ? MAX((int)(vel * 127.0f + 0.5f), 1) : 0;
+			if (p_cmd.duration <= 0.0f) {
+				tsf_channel_note_on(tsf_instance, p_cmd.channel, key, vel);
+				recorder.record(note_clock, 0x90, p_cmd.channel, key, velocity);
+				break;
+			}
+			unsigned int play_index;
+			if (tsf_ext_channel_note_on(tsf_instance, p_cmd.channel, key, vel, &play_index)) {
+				recorder.record(note_clock, 0x90, p_cmd.channel, key, velocity);
+				_schedule_note_off(play_index, p_cmd.duration, p_cmd.channel, key);
+			}
+		} break;
+		case CMD_NOTE_OFF : {
+			int key = CLAMP(p_cmd.param1, 0, 127);
+			tsf_channel_note_off(tsf_instance, p_cmd.channel, key);
+			recorder.record(note_clock, 0x80, p_cmd.channel, key, 0);
+		} break;
+		case CMD_NOTE_OFF_ALL : {
+			tsf_note_off_all(tsf_instance);
+			for (int i = 0; i < used_channel_count; i++) {
+				recorder.record(note_clock, 0xB0, i, 123 /* all notes off */, 0);
+			}
+		} break;
+		case CMD_SET_PRESET : {
+			bool drums = (p_cmd.param2 != 0);
+			tsf_channel_set_presetnumber(tsf_instance, p_cmd.channel, p_cmd.param1, drums);
+			recorder.record(note_clock, 0xC0, p_cmd.channel, p_cmd.param1, 0);
+		} break;
+		case CMD_CONTROL_CHANGE : {
+			tsf_channel_midi_control(tsf_instance, p_cmd.channel, p_cmd.param1, p_cmd.param2);
+			recorder.record(note_clock, 0xB0, p_cmd.channel, p_cmd.param1, p_cmd.param2);
+		} break;
+		case CMD_PITCH_BEND : {
+			tsf_channel_set_pitchwheel(tsf_instance, p_cmd.channel, p_cmd.param1);
+			recorder.record(note_clock, 0xE0, p_cmd.channel, p_cmd.param1, 0);
+		} break;
+		case CMD_CHANNEL_PRESSURE : {
+			tsf_channel_midi_control(tsf_instance, p_cmd.channel, 0x07 /* volume MSB */, p_cmd.param1);
+			recorder.record(note_clock, 0xD0, p_cmd.channel, p_cmd.param1, 0);
+		} break;
+		case CMD_PLAY_NOTE : {
+			int key = CLAMP(p_cmd.param1, 0, 127);
+			float vel = CLAMP(p_cmd.fparam, 0.0f, 1.0f);
+			unsigned int play_index;
+			int stolen = tsf_ext_note_on_stealing(tsf_instance, PLAY_NOTE_CHANNEL, p_cmd.param2, key, vel, &play_index);
+			if (stolen >= 0) {
+				stolen_voice_count.add(stolen);
+				_schedule_note_off(play_index, p_cmd.duration);
+			}
+		} break;
+		default:
+			break;
+	}
+}
+
+void AudioStreamPlaybackSoundfont::_schedule_note_off(unsigned int p_play_index, float p_seconds, int p_channel, int p_key) {
+	if (note_offs.is_full()) {
+		tsf_ext_note_off_play_index(tsf_instance, note_offs.first().play_index);
+		_record_note_off(note_offs.first());
+		note_offs.pop();
+	}
+
+	// commands are applied at the start of a mix, so the note started at note_clock
+	note_offs.push({ note_clock + (uint64_t)(p_seconds * mix_rate), p_play_index, p_channel, p_key });
+}
+
+void AudioStreamPlaybackSoundfont::_release_due_notes(uint64_t p_frame) {
+	while (!note_offs.is_empty() && note_offs.first().frame <= p_frame) {
+		// a note stolen or stopped since is no longer found, which is fine
+		tsf_ext_note_off_play_index(tsf_instance, note_offs.first().play_index);
+		_record_note_off(note_offs.first());
+		note_offs.pop();
+	}
+}
+
+void AudioStreamPlaybackSoundfont::_record_note_off(const ScheduledNoteOff &p_note_off) {
+	if (p_note_off.channel >= 0) {
+		recorder.record(note_clock, 0x80, p_note_off.channel, p_note_off.key, 0);
 	}
 }
 
@@ -119,6 +197,9 @@ int32_t AudioStreamPlaybackSoundfont::_mix(AudioFrame *p_buffer, float p_rate_sc
 #else
 int AudioStreamPlaybackSoundfont::mix(AudioFrame *p_buffer, float p_rate_scale, int p_frames) {
 #endif
+	AudioThreadGuard guard;
+	DenormalGuard denormal_guard;
+
 	if (!active || !tsf_instance) {
 		for (int i = 0; i < p_frames; i++) {
 			p_buffer[i].left = 0.0f;
@@ -128,13 +209,54 @@ int AudioStreamPlaybackSoundfont::mix(AudioFrame *p_buffer, float p_rate_scale,
 	}
 
 	_flush_pending_commands();
+	culled_voice_count.add(tsf_ext_cull_voices(tsf_instance, sf_stream->voice_cull_gain.get()));
 
-	tsf_render_float(tsf_instance, (float *)p_buffer, p_frames, 0);
+	if (tsf_active_voice_count(tsf_instance) == 0) {
+		// an idle instrument costs a voice scan and a clear
+		for (int i = 0; i < p_frames; i++) {
+			p_buffer[i].left = 0.0f;
+			p_buffer[i].right = 0.0f;
+		}
+		upsample_state = LinearUpsampler::State();
+		note_clock += p_frames;
+		_release_due_notes(note_clock);
+		recorder.set_clock(note_clock);
+		frames_mixed += p_frames;
+		return p_frames;
+	}
+
+	// split where scheduled notes end, so their length is exact to the frame
+	int offset = 0;
+	while (offset < p_frames) {
+		_release_due_notes(note_clock);
+		int count = p_frames - offset;
+		if (!note_offs.is_empty() && note_offs.first().frame - note_clock < (uint64_t)count) {
+			count = (int)(note_offs.first().frame - note_clock);
+		}
+		_render_frames(&p_buffer[offset], count);
+		offset += count;
+		note_clock += count;
+	}
+	recorder.set_clock(note_clock);
 	frames_mixed += p_frames;
 
 	return p_frames;
 }
 
+void AudioStreamPlaybackSoundfont::_render_frames(AudioFrame *p_buffer, int p_frames) {
+	if (!upsampling) {
+		tsf_ext_render_float(tsf_instance, (float *)p_buffer, p_frames, 0, quality);
+		return;
+	}
+	for (int offset = 0; offset < p_frames; offset += MIX_BLOCK_SIZE) {
+		int block = MIN(p_frames - offset, MIX_BLOCK_SIZE);
+		int count = upsampler.get_input_count(block);
+		tsf_ext_render_float(tsf_instance, (float *)synth_block, count, 0, quality);
+		upsampler.process(upsample_state, synth_block, &p_buffer[offset], block);
+		upsampler.advance(block);
+	}
+}
+
 #ifdef _GDEXTENSION
 #else
 void AudioStreamPlaybackSoundfont::tag_used_streams() {
@@ -142,15 +264,27 @@ void AudioStreamPlaybackSoundfont::tag_used_streams() {
 }
 #endif
 
-void AudioStreamPlaybackSoundfont::note_on(int p_key, float p_velocity, int p_channel) {
+void AudioStreamPlaybackSoundfont::_setup_output(float p_mix_rate, int p_quality) {
+	quality = p_quality;
+	mix_rate = p_mix_rate;
+	float synth_rate = p_quality == AudioStreamSoundfontPlayer::QUALITY_LOW ? MIN(p_mix_rate, (float)TSF_EXT_LOW_QUALITY_SAMPLE_RATE) : p_mix_rate;
+	upsampling = synth_rate < p_mix_rate;
+	upsampler.setup(synth_rate, p_mix_rate);
+	tsf_set_output(tsf_instance, TSF_STEREO_INTERLEAVED, (int)synth_rate, 0.0f);
+}
+
+void AudioStreamPlaybackSoundfont::note_on(int p_key, float p_velocity, int p_channel, float p_duration) {
 	ERR_FAIL_COND(p_key < 0 || p_key > 127);
+	ERR_FAIL_INDEX(p_channel, channel_count);
+	ERR_FAIL_COND(p_duration < 0.0f);
 	PENDING_MUTEX_LOCK
-	pending_commands.push_back({ CMD_NOTE_ON, p_channel, p_key, 0, p_velocity });
+	pending_commands.push_back({ CMD_NOTE_ON, p_channel, p_key, 0, p_velocity, p_duration });
 	PENDING_MUTEX_UNLOCK
 }
 
 void AudioStreamPlaybackSoundfont::note_off(int p_key, int p_channel) {
 	ERR_FAIL_COND(p_key < 0 || p_key > 127);
+	ERR_FAIL_INDEX(p_channel, channel_count);
 	PENDING_MUTEX_LOCK
 	pending_commands.push_back({ CMD_NOTE_OFF, p_channel, p_key, 0, 0.0f });
 	PENDING_MUTEX_UNLOCK
@@ -162,34 +296,113 @@ void AudioStreamPlaybackSoundfont::note_off_all() {
 	PENDING_MUTEX_UNLOCK
 }
 
+void AudioStreamPlaybackSoundfont::play_note(int p_key, float p_velocity, float p_duration, int p_preset, int p_bank) {
+	ERR_FAIL_COND(p_key < 0 || p_key > 127);
+	ERR_FAIL_COND(p_duration < 0.0f);
+	ERR_FAIL_NULL(tsf_instance);
+	// the presets are shared with the loaded soundfont and never change, the lookup is safe here
+	int preset_index = tsf_get_presetindex(tsf_instance, p_bank, p_preset);
+	ERR_FAIL_COND_MSG(preset_index < 0, vformat("The SoundFont has no preset %d in bank %d.", p_preset, p_bank));
+	PENDING_MUTEX_LOCK
+	pending_commands.push_back({ CMD_PLAY_NOTE, 0, p_key, preset_index, p_velocity, p_duration });
+	PENDING_MUTEX_UNLOCK
+}
+
 void AudioStreamPlaybackSoundfont::set_preset(int p_channel, int p_preset_number, bool p_drums) {
+	ERR_FAIL_INDEX(p_channel, channel_count);
 	PENDING_MUTEX_LOCK
 	pending_commands.push_back({ CMD_SET_PRESET, p_channel, p_preset_number, p_drums ? 1 : 0, 0.0f });
 	PENDING_MUTEX_UNLOCK
 }
 
 void AudioStreamPlaybackSoundfont::control_change(int p_channel, int p_controller, int p_value) {
+	ERR_FAIL_INDEX(p_channel, channel_count);
 	PENDING_MUTEX_LOCK
 	pending_commands.push_back({ CMD_CONTROL_CHANGE, p_channel, p_controller, p_value, 0.0f });
 	PENDING_MUTEX_UNLOCK
 }
 
 void AudioStreamPlaybackSoundfont::pitch_bend(int p_channel, int p_pitch_wheel) {
+	ERR_FAIL_INDEX(p_channel, channel_count);
 	PENDING_MUTEX_LOCK
 	pending_commands.push_back({ CMD_PITCH_BEND, p_channel, p_pitch_wheel, 0, 0.0f });
 	PENDING_MUTEX_UNLOCK
 }
 
 void AudioStreamPlaybackSoundfont::channel_pressure(int p_channel, int p_pressure) {
+	ERR_FAIL_INDEX(p_channel, channel_count);
 	PENDING_MUTEX_LOCK
 	pending_commands.push_back({ CMD_CHANNEL_PRESSURE, p_channel, p_pressure, 0, 0.0f });
 	PENDING_MUTEX_UNLOCK
 }
 
+// caller must hold pending_mutex
+void AudioStreamPlaybackSoundfont::_queue_midi_command(int p_type, int p_channel, int p_param1, int p_param2) {
+	if (p_channel < 0 || p_channel >= channel_count) {
+		return;
+	}
+	switch (p_type) {
+		case 0x90 : { // note on
+			if (p_param2 == 0) {
+				pending_commands.push_back({ CMD_NOTE_OFF, p_channel, p_param1, 0, 0.0f });
+			} else {
+				pending_commands.push_back({ CMD_NOTE_ON, p_channel, p_param1, 0, p_param2 / 127.0f });
+			}
+		} break;
+		case 0x80 : { // note off
+			pending_commands.push_back({ CMD_NOTE_OFF, p_channel, p_param1, 0, 0.0f });
+		} break;
+		case 0xB0 : { // control change
+			pending_commands.push_back({ CMD_CONTROL_CHANGE, p_channel, p_param1, p_param2, 0.0f });
+		} break;
+		case 0xC0 : { // program change
+			pending_commands.push_back({ CMD_SET_PRESET, p_channel, p_param1, (p_channel % 16 == 9) ? 1 : 0, 0.0f });
+		} break;
+		case 0xD0 : { // channel pressure
+			pending_commands.push_back({ CMD_CHANNEL_PRESSURE, p_channel, p_param1, 0, 0.0f });
+		} break;
+		case 0xE0 : { // pitch bend
+			pending_commands.push_back({ CMD_PITCH_BEND, p_channel, p_param1, 0, 0.0f });
+		} break;
+		default:
+			break;
+	}
+}
+
+void AudioStreamPlaybackSoundfont::push_midi_message(int p_type, int p_channel, int p_param1, int p_param2) {
+	PENDING_MUTEX_LOCK
+	_queue_midi_command(p_type, p_channel, p_param1, p_param2);
+	PENDING_MUTEX_UNLOCK
+}
+
+void AudioStreamPlaybackSoundfont::push_midi_messages(const PackedInt32Array &p_messages) {
+	ERR_FAIL_COND_MSG(p_messages.size() % 4 != 0, "Expected [type, channel, param1, param2] quadruples.");
+	const int32_t *r = p_messages.ptr();
+	int count = p_messages.size() / 4;
+
+	PENDING_MUTEX_LOCK
+	pending_commands.reserve(pending_commands.size() + count);
+	for (int i = 0; i < count; i++) {
+		const int32_t *m = r + i * 4;
+		_queue_midi_command(m[0], m[1], m[2], m[3]);
+	}
+	PENDING_MUTEX_UNLOCK
+}
+
+void AudioStreamPlaybackSoundfont::push_midi_bytes(const PackedByteArray &p_bytes) {
+	PENDING_MUTEX_LOCK
+	MIDI::decode_raw_messages(p_bytes.ptr(), p_bytes.size(), [this](int p_type, int p_channel, int p_data1, int p_data2) {
+		_queue_midi_command(p_type, p_channel, p_data1, p_data2);
+	});
+	PENDING_MUTEX_UNLOCK
+}
+
 AudioStreamPlaybackSoundfont::AudioStreamPlaybackSoundfont() {
 #ifdef _GDEXTENSION
 	pending_mutex.instantiate();
 #endif
+	pending_commands.reserve(PENDING_FLUSH_CHUNK);
+	note_offs.resize(MAX_SCHEDULED_NOTE_OFFS);
 }
 
 AudioStreamPlaybackSoundfont::~AudioStreamPlaybackSoundfont() {
@@ -199,15 +412,62 @@ AudioStreamPlaybackSoundfont::~AudioStreamPlaybackSoundfont() {
 	}
 }
 
+void AudioStreamPlaybackSoundfont::start_recording(int p_capacity) {
+	recorder.start(p_capacity, mix_rate);
+}
+
+void AudioStreamPlaybackSoundfont::stop_recording() {
+	recorder.stop();
+}
+
+bool AudioStreamPlaybackSoundfont::is_recording() const {
+	return recorder.is_recording();
+}
+
+int AudioStreamPlaybackSoundfont::get_recording_dropped_count() const {
+	return recorder.get_dropped_count();
+}
+
+Ref<MIDI> AudioStreamPlaybackSoundfont::get_recorded_midi() {
+	return recorder.get_midi();
+}
+
+PackedByteArray AudioStreamPlaybackSoundfont::get_recorded_smf() {
+	return recorder.get_smf();
+}
+
+int AudioStreamPlaybackSoundfont::get_culled_voice_count() const {
+	return culled_voice_count.get();
+}
+
+int AudioStreamPlaybackSoundfont::get_stolen_voice_count() const {
+	return stolen_voice_count.get();
+}
+
 void AudioStreamPlaybackSoundfont::_bind_methods() {
-	ClassDB::bind_method(D_METHOD("note_on", "key", "velocity", "channel"), &AudioStreamPlaybackSoundfont::note_on, DEFVAL(1.0f), DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("note_on", "key", "velocity", "channel", "duration"), &AudioStreamPlaybackSoundfont::note_on, DEFVAL(1.0f), DEFVAL(0), DEFVAL(0.0f));
 	ClassDB::bind_method(D_METHOD("note_off", "key", "channel"), &AudioStreamPlaybackSoundfont::note_off, DEFVAL(0));
 	ClassDB::bind_method(D_METHOD("note_off_all"), &AudioStreamPlaybackSoundfont::note_off_all);
+	ClassDB::bind_method(D_METHOD("play_note", "key", "velocity", "duration", "preset", "bank"), &AudioStreamPlaybackSoundfont::play_note, DEFVAL(1.0f), DEFVAL(0.25f), DEFVAL(0), DEFVAL(0));
 
 	ClassDB::bind_method(D_METHOD("set_preset", "channel", "preset_number", "drums"), &AudioStreamPlaybackSoundfont::set_preset, DEFVAL(false));
 	ClassDB::bind_method(D_METHOD("control_change", "channel", "controller", "value"), &AudioStreamPlaybackSoundfont::control_change);
 	ClassDB::bind_method(D_METHOD("pitch_bend", "channel", "pitch_wheel"), &AudioStreamPlaybackSoundfont::pitch_bend);
 	ClassDB::bind_method(D_METHOD("channel_pressure", "channel", "pressure"), &AudioStreamPlaybackSoundfont::channel_pressure);
+
+	ClassDB::bind_method(D_METHOD("push_midi_message", "type", "channel", "param1", "param2"), &AudioStreamPlaybackSoundfont::push_midi_message, DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("push_midi_messages", "messages"), &AudioStreamPlaybackSoundfont::push_midi_messages);
+	ClassDB::bind_method(D_METHOD("push_midi_bytes", "bytes"), &AudioStreamPlaybackSoundfont::push_midi_bytes);
+
+	ClassDB::bind_method(D_METHOD("start_recording", "capacity"), &AudioStreamPlaybackSoundfont::start_recording, DEFVAL(MIDIRecorder::DEFAULT_CAPACITY));
+	ClassDB::bind_method(D_METHOD("stop_recording"), &AudioStreamPlaybackSoundfont::stop_recording);
+	ClassDB::bind_method(D_METHOD("is_recording"), &AudioStreamPlaybackSoundfont::is_recording);
+	ClassDB::bind_method(D_METHOD("get_recording_dropped_count"), &AudioStreamPlaybackSoundfont::get_recording_dropped_count);
+	ClassDB::bind_method(D_METHOD("get_recorded_midi"), &AudioStreamPlaybackSoundfont::get_recorded_midi);
+	ClassDB::bind_method(D_METHOD("get_recorded_smf"), &AudioStreamPlaybackSoundfont::get_recorded_smf);
+
+	ClassDB::bind_method(D_METHOD("get_culled_voice_count"), &AudioStreamPlaybackSoundfont::get_culled_voice_count);
+	ClassDB::bind_method(D_METHOD("get_stolen_voice_count"), &AudioStreamPlaybackSoundfont::get_stolen_voice_count);
 }
 
 AudioStreamSoundfontPlayer::AudioStreamSoundfontPlayer() {
@@ -224,6 +484,33 @@ Ref<SoundFont2> AudioStreamSoundfontPlayer::get_soundfont() const {
 	return soundfont;
 }
 
+void AudioStreamSoundfontPlayer::set_quality(Quality p_quality) {
+	ERR_FAIL_INDEX((int)p_quality, QUALITY_HIGH + 1);
+	quality = p_quality;
+}
+
+AudioStreamSoundfontPlayer::Quality AudioStreamSoundfontPlayer::get_quality() const {
+	return quality;
+}
+
+void AudioStreamSoundfontPlayer::set_voice_cull_threshold_db(float p_db) {
+	voice_cull_threshold_db = p_db;
+	voice_cull_gain.set(Math::db_to_linear(p_db));
+}
+
+float AudioStreamSoundfontPlayer::get_voice_cull_threshold_db() const {
+	return voice_cull_threshold_db;
+}
+
+void AudioStreamSoundfontPlayer::set_max_voices(int p_max_voices) {
+	ERR_FAIL_COND(p_max_voices < 1);
+	max_voices = p_max_voices;
+}
+
+int AudioStreamSoundfontPlayer::get_max_voices() const {
+	return max_voices;
+}
+
 #ifdef _GDEXTENSION
 Ref<AudioStreamPlayback> AudioStreamSoundfontPlayer::_instantiate_playback() const {
 	ERR_FAIL_COND_V_MSG(soundfont.is_null(), nullptr, "AudioStreamSoundfontPlayer : No SoundFont2 assigned.");
@@ -236,9 +523,10 @@ Ref<AudioStreamPlayback> AudioStreamSoundfontPlayer::_instantiate_playback() con
 	playback->tsf_instance = tsf_copy(soundfont->get_soundfont());
 	ERR_FAIL_COND_V_MSG(!playback->tsf_instance, nullptr, "AudioStreamSoundfontPlayer : Failed to copy SoundFont instance.");
 
-	float sample_rate = AudioServer::get_singleton()->get_mix_rate();
-	tsf_set_output(playback->tsf_instance, TSF_STEREO_INTERLEAVED, (int)sample_rate, 0.0f);
-	tsf_set_max_voices(playback->tsf_instance, 256);
+	playback->_setup_output(AudioServer::get_singleton()->get_mix_rate(), quality);
+	tsf_set_max_voices(playback->tsf_instance, max_voices);
+	tsf_ext_reserve_channels(playback->tsf_instance, AudioStreamPlaybackSoundfont::PLAY_NOTE_CHANNEL + 1);
+	playback->channel_count = AudioStreamPlaybackSoundfont::MAX_CHANNEL_COUNT;
 
 	return playback;
 }
@@ -254,9 +542,10 @@ Ref<AudioStreamPlayback> AudioStreamSoundfontPlayer::instantiate_playback() {
 	playback->tsf_instance = tsf_copy(soundfont->get_soundfont());
 	ERR_FAIL_COND_V_MSG(!playback->tsf_instance, nullptr, "AudioStreamSoundfontPlayer : Failed to copy SoundFont instance.");
 
-	float sample_rate = AudioServer::get_singleton()->get_mix_rate();
-	tsf_set_output(playback->tsf_instance, TSF_STEREO_INTERLEAVED, (int)sample_rate, 0.0f);
-	tsf_set_max_voices(playback->tsf_instance, 256);
+	playback->_setup_output(AudioServer::get_singleton()->get_mix_rate(), quality);
+	tsf_set_max_voices(playback->tsf_instance, max_voices);
+	tsf_ext_reserve_channels(playback->tsf_instance, AudioStreamPlaybackSoundfont::PLAY_NOTE_CHANNEL + 1);
+	playback->channel_count = AudioStreamPlaybackSoundfont::MAX_CHANNEL_COUNT;
 
 	return playback;
 }
@@ -290,5 +579,21 @@ void AudioStreamSoundfontPlayer::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_soundfont", "soundfont"), &AudioStreamSoundfontPlayer::set_soundfont);
 	ClassDB::bind_method(D_METHOD("get_soundfont"), &AudioStreamSoundfontPlayer::get_soundfont);
 
+	ClassDB::bind_method(D_METHOD("set_quality", "quality"), &AudioStreamSoundfontPlayer::set_quality);
+	ClassDB::bind_method(D_METHOD("get_quality"), &AudioStreamSoundfontPlayer::get_quality);
+
+	ClassDB::bind_method(D_METHOD("set_voice_cull_threshold_db", "db"), &AudioStreamSoundfontPlayer::set_voice_cull_threshold_db);
+	ClassDB::bind_method(D_METHOD("get_voice_cull_threshold_db"), &AudioStreamSoundfontPlayer::get_voice_cull_threshold_db);
+
+	ClassDB::bind_method(D_METHOD("set_max_voices", "max_voices"), &AudioStreamSoundfontPlayer::set_max_voices);
+	ClassDB::bind_method(D_METHOD("get_max_voices"), &AudioStreamSoundfontPlayer::get_max_voices);
+
 	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "soundfont", PROPERTY_HINT_RESOURCE_TYPE, "SoundFont2"), "set_soundfont", "get_soundfont");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "quality", PROPERTY_HINT_ENUM, "Low,Normal,High"), "set_quality", "get_quality");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "max_voices", PROPERTY_HINT_RANGE, "1,1024,1,or_greater"), "set_max_voices", "get_max_voices");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "voice_cull_threshold_db", PROPERTY_HINT_RANGE, "-144,0,0.1,suffix:dB"), "set_voice_cull_threshold_db", "get_voice_cull_threshold_db");
+
+	BIND_ENUM_CONSTANT(QUALITY_LOW);
+	BIND_ENUM_CONSTANT(QUALITY_NORMAL);
+	BIND_ENUM_CONSTANT(QUALITY_HIGH);
 }
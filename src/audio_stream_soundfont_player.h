@@ -16,6 +16,9 @@ using namespace godot;
 #include "core/templates/safe_refcount.h"
 #endif
 
+#include "frame_heap.h"
+#include "linear_upsampler.h"
+#include "midi_recorder.h"
 #include "soundfont2.h"
 
 struct tsf;
@@ -37,6 +40,41 @@ private:
 	tsf *tsf_instance = nullptr;
 	uint32_t frames_mixed = 0;
 	bool active = false;
+	SafeNumeric<uint32_t> culled_voice_count;
+	SafeNumeric<uint32_t> stolen_voice_count;
+
+	// see AudioStreamSoundfontPlayer::Quality, low quality renders below the mix rate and upsamples
+	static const int MIX_BLOCK_SIZE = 64;
+	int quality = 1; // TSF_EXT_QUALITY_NORMAL
+	float mix_rate = 44100.0f;
+	bool upsampling = false;
+	LinearUpsampler upsampler;
+	LinearUpsampler::State upsample_state;
+	AudioFrame synth_block[MIX_BLOCK_SIZE];
+
+	void _setup_output(float p_mix_rate, int p_quality);
+	// renders p_frames without splitting them for note-offs
+	void _render_frames(AudioFrame *p_buffer, int p_frames);
+
+	// note-offs of play_note and of note_on with a duration. the capacity is fixed,
+	// when it runs out the note due first is released early to make room
+	static const int MAX_SCHEDULED_NOTE_OFFS = 4096;
+	struct ScheduledNoteOff {
+		uint64_t frame;
+		unsigned int play_index;
+		int channel; // -1 for play_note, which has none and isn't recorded
+		int key;
+	};
+	FrameHeap<ScheduledNoteOff> note_offs;
+	uint64_t note_clock = 0; // frames mixed while active, audio thread only
+
+	void _schedule_note_off(unsigned int p_play_index, float p_seconds, int p_channel = -1, int p_key = 0);
+	// releases every note due at or before p_frame
+	void _release_due_notes(uint64_t p_frame);
+	void _record_note_off(const ScheduledNoteOff &p_note_off);
+
+	// applied commands are logged at note_clock
+	MIDIRecorder recorder;
 
 	enum PendingCommandType {
 		CMD_NOTE_ON,
@@ -46,6 +84,7 @@ private:
 		CMD_CONTROL_CHANGE,
 		CMD_PITCH_BEND,
 		CMD_CHANNEL_PRESSURE,
+		CMD_PLAY_NOTE,
 	};
 
 	struct PendingCommand {
@@ -54,6 +93,7 @@ private:
 		int param1;
 		int param2;
 		float fparam;
+		float duration = 0.0f; // seconds
 	};
 
 #ifdef _GDEXTENSION
@@ -63,7 +103,22 @@ private:
 #endif
 	LocalVector<PendingCommand> pending_commands;
 
+	// audio thread side copy of pending_commands, taken in fixed-size chunks so flushing never allocates
+	static const int PENDING_FLUSH_CHUNK = 256;
+	PendingCommand flush_buffer[PENDING_FLUSH_CHUNK];
+
+	// 16 ports of 16 channels, like AudioStreamMIDI. all of them are reserved at instantiate so the
+	// audio thread never allocates tsf channels
+	static const int MAX_CHANNEL_COUNT = 256;
+	// reserved past the MIDI channels for play_note, so its voices never pick up the controllers
+	// of a channel in use or get cut by its note and sound offs
+	static const int PLAY_NOTE_CHANNEL = MAX_CHANNEL_COUNT;
+	int channel_count = 0; // tsf channels reserved for the channel API
+	int used_channel_count = 16; // audio thread, highest channel touched + 1, for recording note_off_all
+
 	void _flush_pending_commands();
+	void _apply_command(const PendingCommand &p_cmd);
+	void _queue_midi_command(int p_type, int p_channel, int p_param1, int p_param2);
 
 protected:
 	static void _bind_methods();
@@ -93,15 +148,31 @@ public:
 	virtual void tag_used_streams() override;
 #endif
 
-	void note_on(int p_key, float p_velocity = 1.0f, int p_channel = 0);
+	void note_on(int p_key, float p_velocity = 1.0f, int p_channel = 0, float p_duration = 0.0f);
 	void note_off(int p_key, int p_channel = 0);
 	void note_off_all();
 
+	void play_note(int p_key, float p_velocity = 1.0f, float p_duration = 0.25f, int p_preset = 0, int p_bank = 0);
+
 	void set_preset(int p_channel, int p_preset_number, bool p_drums = false);
 	void control_change(int p_channel, int p_controller, int p_value);
 	void pitch_bend(int p_channel, int p_pitch_wheel);
 	void channel_pressure(int p_channel, int p_pressure);
 
+	void push_midi_message(int p_type, int p_channel, int p_param1, int p_param2 = 0);
+	void push_midi_messages(const PackedInt32Array &p_messages);
+	void push_midi_bytes(const PackedByteArray &p_bytes);
+
+	void start_recording(int p_capacity = MIDIRecorder::DEFAULT_CAPACITY);
+	void stop_recording();
+	bool is_recording() const;
+	int get_recording_dropped_count() const;
+	Ref<MIDI> get_recorded_midi();
+	PackedByteArray get_recorded_smf();
+
+	int get_culled_voice_count() const;
+	int get_stolen_voice_count() const;
+
 	AudioStreamPlaybackSoundfont();
 	~AudioStreamPlaybackSoundfont();
 };
@@ -112,7 +183,20 @@ class AudioStreamSoundfontPlayer : public AudioStream {
 	OBJ_SAVE_TYPE(AudioStream);
 #endif
 
+public:
+	// same values as tsf_ext_quality
+	enum Quality {
+		QUALITY_LOW,
+		QUALITY_NORMAL,
+		QUALITY_HIGH,
+	};
+
+private:
 	Ref<SoundFont2> soundfont;
+	Quality quality = QUALITY_NORMAL;
+	float voice_cull_threshold_db = -80.0f;
+	SafeNumeric<float> voice_cull_gain{ 0.0001f }; // linear voice_cull_threshold_db, read by the audio thread
+	int max_voices = 256;
 
 	friend class AudioStreamPlaybackSoundfont;
 
@@ -123,6 +207,15 @@ public:
 	void set_soundfont(const Ref<SoundFont2> &p_soundfont);
 	Ref<SoundFont2> get_soundfont() const;
 
+	void set_quality(Quality p_quality);
+	Quality get_quality() const;
+
+	void set_voice_cull_threshold_db(float p_db);
+	float get_voice_cull_threshold_db() const;
+
+	void set_max_voices(int p_max_voices);
+	int get_max_voices() const;
+
 #ifdef _GDEXTENSION
 	virtual Ref<AudioStreamPlayback> _instantiate_playback() const override;
 	virtual String _get_stream_name() const override;
@@ -138,3 +231,5 @@ public:
 	AudioStreamSoundfontPlayer();
 	~AudioStreamSoundfontPlayer();
 };
+
+VARIANT_ENUM_CAST(AudioStreamSoundfontPlayer::Quality);
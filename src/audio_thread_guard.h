@@ -0,0 +1,78 @@
+#pragma once
+
+#ifdef _GDEXTENSION
+#include <godot_cpp/core/error_macros.hpp>
+#include <godot_cpp/core/memory.hpp>
+#include <godot_cpp/templates/safe_refcount.hpp>
+using namespace godot;
+#else
+#include "core/error/error_macros.h"
+#include "core/os/memory.h"
+#include "core/templates/safe_refcount.h"
+#endif
+
+/*
+	marks code running on the mix thread. in debug builds, tsf/tml allocations
+	go through audio_thread_guard_malloc & co. (see tsf_impl.h and tml_impl.h)
+	and any allocation made while a guard is alive is counted and reported once.
+*/
+
+#ifdef DEBUG_ENABLED
+#define MIDI_TRACK_AUDIO_THREAD_ALLOCATIONS
+#endif
+
+#ifdef MIDI_TRACK_AUDIO_THREAD_ALLOCATIONS
+
+inline thread_local int audio_thread_guard_depth = 0;
+inline SafeNumeric<uint32_t> audio_thread_allocation_count;
+inline SafeFlag audio_thread_allocation_reported;
+
+struct AudioThreadGuard {
+	AudioThreadGuard() {
+		audio_thread_guard_depth++;
+	}
+	~AudioThreadGuard() {
+		audio_thread_guard_depth--;
+	}
+};
+
+inline void audio_thread_guard_check() {
+	if (audio_thread_guard_depth == 0) {
+		return;
+	}
+	audio_thread_allocation_count.increment();
+	if (!audio_thread_allocation_reported.is_set()) {
+		audio_thread_allocation_reported.set();
+		WARN_PRINT("MIDI: memory was allocated or freed on the audio thread, this can cause dropouts.");
+	}
+}
+
+inline void *audio_thread_guard_malloc(size_t p_size) {
+	audio_thread_guard_check();
+	return memalloc(p_size);
+}
+
+inline void *audio_thread_guard_realloc(void *p_ptr, size_t p_size) {
+	audio_thread_guard_check();
+	return memrealloc(p_ptr, p_size);
+}
+
+inline void audio_thread_guard_free(void *p_ptr) {
+	audio_thread_guard_check();
+	memfree(p_ptr);
+}
+
+inline uint32_t audio_thread_guard_get_allocation_count() {
+	return audio_thread_allocation_count.get();
+}
+
+#else
+
+struct AudioThreadGuard {
+};
+
+inline uint32_t audio_thread_guard_get_allocation_count() {
+	return 0;
+}
+
+#endif
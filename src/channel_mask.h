@@ -0,0 +1,59 @@
+#pragma once
+
+#ifdef _GDEXTENSION
+#include <godot_cpp/templates/safe_refcount.hpp>
+using namespace godot;
+#else
+#include "core/templates/safe_refcount.h"
+#endif
+
+/*
+	one bit per MIDI channel, packed in 64-bit words.
+	written from the main thread, tested lock-free on the audio thread,
+	so per-event checks are a single load no matter how many channels there are.
+*/
+
+template <int N>
+class ChannelMask {
+public:
+	static const int WORD_COUNT = (N + 63) / 64;
+
+private:
+	SafeNumeric<uint64_t> words[WORD_COUNT];
+
+public:
+	// out of range channels are never set
+	bool has(int p_channel) const {
+		if ((uint32_t)p_channel >= (uint32_t)N) {
+			return false;
+		}
+		return (words[p_channel >> 6].get() >> (p_channel & 63)) & 1;
+	}
+
+	void set(int p_channel, bool p_enable) {
+		if ((uint32_t)p_channel >= (uint32_t)N) {
+			return;
+		}
+		uint64_t bit = uint64_t(1) << (p_channel & 63);
+		if (p_enable) {
+			words[p_channel >> 6].bit_or(bit);
+		} else {
+			words[p_channel >> 6].bit_and(~bit);
+		}
+	}
+
+	uint64_t get_word(int p_word) const {
+		return words[p_word].get();
+	}
+
+	void set_word(int p_word, uint64_t p_bits) {
+		words[p_word].set(p_bits);
+	}
+
+	void fill(bool p_enable) {
+		for (int i = 0; i < WORD_COUNT; i++) {
+			int bits = N - i * 64;
+			words[i].set(p_enable ? (bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1) : 0);
+		}
+	}
+};
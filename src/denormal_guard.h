@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MIDI_DENORMAL_GUARD_SSE
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define MIDI_DENORMAL_GUARD_AARCH64
+#elif defined(__arm__) && defined(__ARM_FP)
+#define MIDI_DENORMAL_GUARD_ARM
+#endif
+
+/*
+	flushes denormal floats to zero while alive and restores the previous mode.
+	release tails, filter states and the reverb feedback decay towards zero and
+	pass through the denormal range, where x86 float math gets many times slower.
+	put one at the top of every function that renders audio.
+*/
+
+#if defined(MIDI_DENORMAL_GUARD_SSE)
+
+struct DenormalGuard {
+	// flush-to-zero (bit 15) and denormals-are-zero (bit 6)
+	static const unsigned int FLAGS = 0x8040;
+	unsigned int previous;
+
+	DenormalGuard() {
+		previous = _mm_getcsr();
+		_mm_setcsr(previous | FLAGS);
+	}
+	~DenormalGuard() {
+		_mm_setcsr(previous);
+	}
+};
+
+#elif defined(MIDI_DENORMAL_GUARD_AARCH64) && !defined(_MSC_VER)
+
+struct DenormalGuard {
+	// FPCR.FZ
+	static const uint64_t FLAGS = uint64_t(1) << 24;
+	uint64_t previous;
+
+	DenormalGuard() {
+		__asm__ __volatile__("mrs %0, fpcr" : "=r"(previous));
+		uint64_t mode = previous | FLAGS;
+		__asm__ __volatile__("msr fpcr, %0" : : "r"(mode));
+	}
+	~DenormalGuard() {
+		__asm__ __volatile__("msr fpcr, %0" : : "r"(previous));
+	}
+};
+
+#elif defined(MIDI_DENORMAL_GUARD_ARM)
+
+struct DenormalGuard {
+	// FPSCR.FZ
+	static const uint32_t FLAGS = uint32_t(1) << 24;
+	uint32_t previous;
+
+	DenormalGuard() {
+		__asm__ __volatile__("vmrs %0, fpscr" : "=r"(previous));
+		uint32_t mode = previous | FLAGS;
+		__asm__ __volatile__("vmsr fpscr, %0" : : "r"(mode));
+	}
+	~DenormalGuard() {
+		__asm__ __volatile__("vmsr fpscr, %0" : : "r"(previous));
+	}
+};
+
+#else
+
+// wasm and others either have no denormal penalty or no way to change the mode.
+// the constructor keeps `DenormalGuard denormal_guard;` from being an unused variable
+struct DenormalGuard {
+	DenormalGuard() {}
+};
+
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+#ifdef _GDEXTENSION
+#include <godot_cpp/core/error_macros.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
+using namespace godot;
+#else
+#include "core/error/error_macros.h"
+#include "core/templates/local_vector.h"
+#endif
+
+/*
+	binary min-heap of entries ordered by their `frame` member, for things due at a frame of the mix.
+	storage is allocated once by resize(), after that push/pop never allocate, so it can be used on
+	the audio thread. the capacity is fixed, push() on a full heap is an error: pop the first one.
+*/
+
+template <typename T>
+class FrameHeap {
+	LocalVector<T> data;
+	uint32_t count = 0;
+
+public:
+	void resize(uint32_t p_capacity) {
+		data.resize(p_capacity);
+		count = 0;
+	}
+
+	uint32_t capacity() const {
+		return data.size();
+	}
+
+	uint32_t size() const {
+		return count;
+	}
+
+	bool is_empty() const {
+		return count == 0;
+	}
+
+	bool is_full() const {
+		return count == data.size();
+	}
+
+	void clear() {
+		count = 0;
+	}
+
+	// the entry with the lowest frame, entries due at the same frame come out in any order
+	const T &first() const {
+		return data[0];
+	}
+
+	void push(const T &p_value) {
+		ERR_FAIL_COND(count == data.size());
+		uint32_t i = count++;
+		while (i > 0) {
+			uint32_t parent = (i - 1) / 2;
+			if (data[parent].frame <= p_value.frame) {
+				break;
+			}
+			data[i] = data[parent];
+			i = parent;
+		}
+		data[i] = p_value;
+	}
+
+	void pop() {
+		ERR_FAIL_COND(count == 0);
+		const T last = data[--count];
+		uint32_t i = 0;
+		while (true) {
+			uint32_t child = i * 2 + 1;
+			if (child >= count) {
+				break;
+			}
+			if (child + 1 < count && data[child + 1].frame < data[child].frame) {
+				child++;
+			}
+			if (last.frame <= data[child].frame) {
+				break;
+			}
+			data[i] = data[child];
+			i = child;
+		}
+		data[i] = last;
+	}
+};
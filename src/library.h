@@ -9,7 +9,9 @@ using namespace godot;
 #endif
 
 #include "audio_stream_midi.h"
+#include "audio_stream_midi_stem.h"
 #include "audio_stream_soundfont_player.h"
+#include "midi_input_router.h"
 #include "ui/virtual_keyboard.h"
 
 static Ref<ResourceFormatLoaderMIDI> resource_loader_midi;
@@ -26,8 +28,11 @@ inline void initialize_library_midi(ModuleInitializationLevel p_level) {
 	GDREGISTER_CLASS(ResourceFormatLoaderSoundFont);
 	GDREGISTER_CLASS(AudioStreamMIDI);
 	GDREGISTER_CLASS(AudioStreamPlaybackMIDISF2);
+	GDREGISTER_CLASS(AudioStreamMIDIStem);
+	GDREGISTER_CLASS(AudioStreamPlaybackMIDIStem);
 	GDREGISTER_CLASS(AudioStreamSoundfontPlayer);
 	GDREGISTER_CLASS(AudioStreamPlaybackSoundfont);
+	GDREGISTER_CLASS(MIDIInputRouter);
 	GDREGISTER_CLASS(VirtualKeyboard);
 
 	resource_loader_midi.instantiate();
@@ -0,0 +1,68 @@
+#pragma once
+
+#ifdef _GDEXTENSION
+#include <godot_cpp/classes/audio_frame.hpp>
+using namespace godot;
+#else
+#include "core/math/audio_frame.h"
+#endif
+
+/*
+	brings a synthesizer running below the mix rate up to it by linear interpolation.
+	the output lags one input frame behind, so every block of output frames needs
+	exactly get_input_count() new input frames and never waits on future ones.
+	several streams rendered in lock-step (stems) share the position and keep
+	their own State.
+*/
+
+class LinearUpsampler {
+	float step = 1.0f; // input frames per output frame
+	float frac = 0.0f; // position of the next output frame past State::prev
+
+public:
+	struct State {
+		AudioFrame prev = { 0.0f, 0.0f };
+		AudioFrame next = { 0.0f, 0.0f };
+	};
+
+	void setup(float p_input_rate, float p_output_rate) {
+		step = p_input_rate / p_output_rate;
+		frac = 0.0f;
+	}
+
+	int get_input_count(int p_frames) const {
+		return (int)(frac + p_frames * step);
+	}
+
+	// p_in holds get_input_count(p_frames) frames
+	void process(State &r_state, const AudioFrame *p_in, AudioFrame *p_out, int p_frames) const {
+		int count = get_input_count(p_frames);
+		for (int i = 0; i < p_frames; i++) {
+			// index 0 is prev, 1 is next, then p_in
+			float position = frac + i * step;
+			int index = (int)position;
+			if (index > count) {
+				index = count;
+			}
+			float alpha = position - index;
+			const AudioFrame &a = index == 0 ? r_state.prev : (index == 1 ? r_state.next : p_in[index - 2]);
+			const AudioFrame &b = index == 0 ? r_state.next : p_in[index - 1];
+			p_out[i].left = a.left + (b.left - a.left) * alpha;
+			p_out[i].right = a.right + (b.right - a.right) * alpha;
+		}
+
+		if (count == 1) {
+			r_state.prev = r_state.next;
+			r_state.next = p_in[0];
+		} else if (count > 1) {
+			r_state.prev = p_in[count - 2];
+			r_state.next = p_in[count - 1];
+		}
+	}
+
+	// call once per block, after every State was processed
+	void advance(int p_frames) {
+		float position = frac + p_frames * step;
+		frac = position - (int)position;
+	}
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#ifdef _GDEXTENSION
+#include <godot_cpp/templates/local_vector.hpp>
+#include <godot_cpp/templates/safe_refcount.hpp>
+using namespace godot;
+#else
+#include "core/templates/local_vector.h"
+#include "core/templates/safe_refcount.h"
+#endif
+
+/*
+	single-producer / single-consumer ring buffer.
+	storage is allocated once by resize() (not thread-safe, call it before
+	both sides start), after that push/pop never allocate or lock.
+	positions are free-running counters, the capacity is a power of two.
+*/
+
+template <typename T>
+class LockFreeRingBuffer {
+	LocalVector<T> data;
+	uint32_t mask = 0;
+	SafeNumeric<uint32_t> write_pos;
+	SafeNumeric<uint32_t> read_pos;
+
+public:
+	void resize(uint32_t p_capacity) {
+		uint32_t capacity = 1;
+		while (capacity < p_capacity) {
+			capacity <<= 1;
+		}
+		data.resize(capacity);
+		mask = capacity - 1;
+		write_pos.set(0);
+		read_pos.set(0);
+	}
+
+	uint32_t capacity() const {
+		return data.size();
+	}
+
+	uint32_t data_left() const {
+		return write_pos.get() - read_pos.get();
+	}
+
+	uint32_t space_left() const {
+		return data.size() - data_left();
+	}
+
+	// producer side
+
+	bool push(const T &p_value) {
+		uint32_t w = write_pos.get();
+		if (w - read_pos.get() >= data.size()) {
+			return false;
+		}
+		data[w & mask] = p_value;
+		write_pos.set(w + 1);
+		return true;
+	}
+
+	uint32_t write(const T *p_src, uint32_t p_count) {
+		uint32_t w = write_pos.get();
+		uint32_t space = data.size() - (w - read_pos.get());
+		uint32_t count = MIN(p_count, space);
+		for (uint32_t i = 0; i < count; i++) {
+			data[(w + i) & mask] = p_src[i];
+		}
+		write_pos.set(w + count);
+		return count;
+	}
+
+	uint32_t get_write_position() const {
+		return write_pos.get();
+	}
+
+	// consumer side
+
+	uint32_t get_read_position() const {
+		return read_pos.get();
+	}
+
+	bool pop(T &r_value) {
+		uint32_t r = read_pos.get();
+		if (r == write_pos.get()) {
+			return false;
+		}
+		r_value = data[r & mask];
+		read_pos.set(r + 1);
+		return true;
+	}
+
+	uint32_t read(T *p_dst, uint32_t p_count) {
+		uint32_t r = read_pos.get();
+		uint32_t count = MIN(p_count, write_pos.get() - r);
+		for (uint32_t i = 0; i < count; i++) {
+			p_dst[i] = data[(r + i) & mask];
+		}
+		read_pos.set(r + count);
+		return count;
+	}
+
+	// drops everything written before p_position (as returned by get_write_position).
+	// only ever moves forward: a position already read past is left alone, moving back
+	// would replay data and let the producer overwrite what isn't read yet
+	void skip_to(uint32_t p_position) {
+		uint32_t r = read_pos.get();
+		if ((int32_t)(p_position - r) > 0) {
+			read_pos.set(p_position);
+		}
+	}
+
+	void clear() {
+		read_pos.set(write_pos.get());
+	}
+};
@@ -1,14 +1,471 @@
 #include "midi.h"
 
 #ifdef _GDEXTENSION
+#include <godot_cpp/templates/local_vector.hpp>
 #else
 #include "core/error/error_macros.h"
 #include "core/io/file_access.h"
 #include "core/object/class_db.h"
+#include "core/templates/local_vector.h"
 #endif
 
 #include "tml_impl.h"
 
+/*
+	tml has no notion of MIDI ports, every track ends up on channels 0-15.
+	files that spread tracks over several ports (meta event 0x21) are scanned
+	here first, then each track is parsed on its own and its channels are
+	offset by 16 * port, so port 1 channel 0 becomes channel 16 and so on.
+*/
+
+struct SMFTrack {
+	int offset = 0;
+	int length = 0;
+	int port = 0;
+};
+
+struct SMFTempoEvent {
+	uint32_t tick = 0;
+	uint8_t data[3] = {};
+
+	bool operator<(const SMFTempoEvent &p_other) const {
+		return tick < p_other.tick;
+	}
+};
+
+struct SMFSortEntry {
+	uint64_t key; // time << 32 | original order, keeps equal times stable
+	tml_message message;
+
+	bool operator<(const SMFSortEntry &p_other) const {
+		return key < p_other.key;
+	}
+};
+
+static uint32_t _smf_read_be32(const uint8_t *p_data) {
+	return (uint32_t(p_data[0]) << 24) | (uint32_t(p_data[1]) << 16) | (uint32_t(p_data[2]) << 8) | uint32_t(p_data[3]);
+}
+
+static bool _smf_read_vlq(const uint8_t *p_data, int p_size, int &r_pos, uint32_t &r_value) {
+	r_value = 0;
+	for (int i = 0; i < 4; i++) {
+		if (r_pos >= p_size) {
+			return false;
+		}
+		uint8_t byte = p_data[r_pos++];
+		r_value = (r_value << 7) | (byte & 0x7F);
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void _smf_write_vlq(LocalVector<uint8_t> &r_out, uint32_t p_value) {
+	uint8_t bytes[4];
+	int count = 0;
+	do {
+		bytes[count++] = p_value & 0x7F;
+		p_value >>= 7;
+	} while (p_value && count < 4);
+	while (count > 0) {
+		count--;
+		r_out.push_back(bytes[count] | (count > 0 ? 0x80 : 0));
+	}
+}
+
+static void _smf_write_be32(LocalVector<uint8_t> &r_out, uint32_t p_value) {
+	r_out.push_back(p_value >> 24);
+	r_out.push_back(p_value >> 16);
+	r_out.push_back(p_value >> 8);
+	r_out.push_back(p_value);
+}
+
+// a port change in the middle of a track is rare, the first assignment applies to the whole track
+static void _smf_scan_track(const uint8_t *p_data, int p_size, SMFTrack &r_track, LocalVector<SMFTempoEvent> &r_tempos) {
+	int pos = 0;
+	uint32_t tick = 0;
+	int status = 0;
+	bool port_found = false;
+	while (pos < p_size) {
+		uint32_t delta = 0;
+		if (!_smf_read_vlq(p_data, p_size, pos, delta) || pos >= p_size) {
+			return;
+		}
+		tick += delta;
+
+		int byte = p_data[pos];
+		if (byte == 0xFF) {
+			if (pos + 2 > p_size) {
+				return;
+			}
+			int type = p_data[pos + 1];
+			pos += 2;
+			uint32_t length = 0;
+			if (!_smf_read_vlq(p_data, p_size, pos, length) || length > (uint32_t)(p_size - pos)) {
+				return;
+			}
+			if (type == 0x21 && length >= 1 && !port_found) {
+				r_track.port = p_data[pos];
+				port_found = true;
+			} else if (type == 0x51 && length == 3) {
+				SMFTempoEvent tempo;
+				tempo.tick = tick;
+				tempo.data[0] = p_data[pos];
+				tempo.data[1] = p_data[pos + 1];
+				tempo.data[2] = p_data[pos + 2];
+				r_tempos.push_back(tempo);
+			} else if (type == 0x2F) {
+				return;
+			}
+			pos += length;
+			status = 0;
+		} else if (byte == 0xF0 || byte == 0xF7) {
+			pos++;
+			uint32_t length = 0;
+			if (!_smf_read_vlq(p_data, p_size, pos, length)) {
+				return;
+			}
+			pos += length;
+			status = 0;
+		} else {
+			if (byte & 0x80) {
+				status = byte;
+				pos++;
+			} else if (status == 0) {
+				return;
+			}
+			int type = status & 0xF0;
+			pos += (type == 0xC0 || type == 0xD0) ? 1 : 2;
+		}
+	}
+}
+
+static bool _smf_scan(const uint8_t *p_data, int p_size, LocalVector<SMFTrack> &r_tracks, LocalVector<SMFTempoEvent> &r_tempos) {
+	if (p_size < 14 || memcmp(p_data, "MThd", 4) != 0) {
+		return false;
+	}
+	uint32_t header_length = _smf_read_be32(p_data + 4);
+	if (header_length < 6 || header_length > (uint32_t)p_size - 8) {
+		return false;
+	}
+
+	int pos = 8 + header_length;
+	while (pos + 8 <= p_size) {
+		int start = pos + 8;
+		int length = (int)MIN(_smf_read_be32(p_data + pos + 4), (uint32_t)(p_size - start));
+		if (memcmp(p_data + pos, "MTrk", 4) == 0) {
+			SMFTrack track;
+			track.offset = start;
+			track.length = length;
+			_smf_scan_track(p_data + start, length, track, r_tempos);
+			r_tracks.push_back(track);
+		}
+		pos = start + length;
+	}
+	return true;
+}
+
+// builds a format 1 file from the tempo map and (optionally) one track, so tml computes the same timing for every track
+static tml_message *_smf_load_track(const uint8_t *p_data, const LocalVector<uint8_t> &p_conductor, const SMFTrack *p_track) {
+	LocalVector<uint8_t> file;
+	file.reserve(22 + p_conductor.size() + 8 + (p_track ? p_track->length : 0));
+	const uint8_t header[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, uint8_t(p_track ? 2 : 1), p_data[12], p_data[13] };
+	for (uint32_t i = 0; i < sizeof(header); i++) {
+		file.push_back(header[i]);
+	}
+
+	file.push_back('M');
+	file.push_back('T');
+	file.push_back('r');
+	file.push_back('k');
+	_smf_write_be32(file, p_conductor.size());
+	for (uint32_t i = 0; i < p_conductor.size(); i++) {
+		file.push_back(p_conductor[i]);
+	}
+
+	if (p_track) {
+		file.push_back('M');
+		file.push_back('T');
+		file.push_back('r');
+		file.push_back('k');
+		_smf_write_be32(file, p_track->length);
+		for (int i = 0; i < p_track->length; i++) {
+			file.push_back(p_data[p_track->offset + i]);
+		}
+	}
+	return tml_load_memory(file.ptr(), file.size());
+}
+
+static tml_message *_smf_load(const uint8_t *p_data, int p_size, int &r_channel_count) {
+	r_channel_count = 16;
+
+	LocalVector<SMFTrack> tracks;
+	LocalVector<SMFTempoEvent> tempos;
+	if (!_smf_scan(p_data, p_size, tracks, tempos) || tracks.size() < 2) {
+		return tml_load_memory(p_data, p_size);
+	}
+
+	// ports are packed densely, a file using ports 0 and 3 gets 32 channels.
+	// tml_message::channel is a byte, so ports past the 16th share the last one
+	int port_index[256];
+	for (int i = 0; i < 256; i++) {
+		port_index[i] = -1;
+	}
+	for (uint32_t i = 0; i < tracks.size(); i++) {
+		port_index[tracks[i].port] = 0;
+	}
+	int port_count = 0;
+	for (int i = 0; i < 256; i++) {
+		if (port_index[i] == 0) {
+			port_index[i] = MIN(port_count, 15);
+			port_count++;
+		}
+	}
+	if (port_count < 2) {
+		return tml_load_memory(p_data, p_size);
+	}
+	port_count = MIN(port_count, 16);
+
+	// tempo changes may sit in any track, gather them in a conductor track
+	tempos.sort();
+	LocalVector<uint8_t> conductor;
+	uint32_t last_tick = 0;
+	for (uint32_t i = 0; i < tempos.size(); i++) {
+		_smf_write_vlq(conductor, tempos[i].tick - last_tick);
+		last_tick = tempos[i].tick;
+		conductor.push_back(0xFF);
+		conductor.push_back(0x51);
+		conductor.push_back(0x03);
+		conductor.push_back(tempos[i].data[0]);
+		conductor.push_back(tempos[i].data[1]);
+		conductor.push_back(tempos[i].data[2]);
+	}
+	conductor.push_back(0x00);
+	conductor.push_back(0xFF);
+	conductor.push_back(0x2F);
+	conductor.push_back(0x00);
+
+	LocalVector<SMFSortEntry> entries;
+	uint32_t order = 0;
+
+	tml_message *tempo_messages = _smf_load_track(p_data, conductor, nullptr);
+	for (tml_message *msg = tempo_messages; msg; msg = msg->next) {
+		if (msg->type == TML_SET_TEMPO) {
+			entries.push_back({ (uint64_t(msg->time) << 32) | order++, *msg });
+		}
+	}
+	tml_free(tempo_messages);
+
+	for (uint32_t i = 0; i < tracks.size(); i++) {
+		tml_message *track_messages = _smf_load_track(p_data, conductor, &tracks[i]);
+		int channel_offset = port_index[tracks[i].port] * 16;
+		for (tml_message *msg = track_messages; msg; msg = msg->next) {
+			// tempo messages were taken from the conductor track already
+			if (msg->type == TML_SET_TEMPO) {
+				continue;
+			}
+			SMFSortEntry entry = { (uint64_t(msg->time) << 32) | order++, *msg };
+			entry.message.channel = channel_offset + msg->channel;
+			entries.push_back(entry);
+		}
+		tml_free(track_messages);
+	}
+
+	if (entries.is_empty()) {
+		return tml_load_memory(p_data, p_size);
+	}
+	entries.sort();
+
+	// one block, like tml allocates it, so tml_free releases it
+	tml_message *messages = (tml_message *)TML_MALLOC(sizeof(tml_message) * entries.size());
+	ERR_FAIL_NULL_V(messages, nullptr);
+	for (uint32_t i = 0; i < entries.size(); i++) {
+		messages[i] = entries[i].message;
+		messages[i].next = (i + 1 < entries.size()) ? &messages[i + 1] : nullptr;
+	}
+
+	r_channel_count = port_count * 16;
+	return messages;
+}
+
+void MIDI::_build_note_index() {
+	note_spans.clear();
+	checkpoint_offsets.clear();
+	checkpoint_spans.clear();
+
+	// pair every note on with the note off that releases it. a note off releases every
+	// voice of its key (as tsf_channel_note_off does), so repeated note ons are chained
+	LocalVector<uint32_t> open_head;
+	LocalVector<uint32_t> open_next;
+	open_head.resize(channel_count * 128);
+	for (uint32_t i = 0; i < open_head.size(); i++) {
+		open_head[i] = NOTE_SPAN_OPEN;
+	}
+
+	uint32_t song_msec = 0;
+	for (tml_message *msg = midi; msg; msg = msg->next) {
+		song_msec = msg->time;
+		length_msec = song_msec;
+		bool note_on = msg->type == TML_NOTE_ON && msg->velocity > 0;
+		bool note_off = msg->type == TML_NOTE_OFF || (msg->type == TML_NOTE_ON && msg->velocity == 0);
+		if ((!note_on && !note_off) || msg->channel >= channel_count) {
+			continue;
+		}
+		uint32_t slot = msg->channel * 128 + msg->key;
+		if (note_on) {
+			open_next.push_back(open_head[slot]);
+			open_head[slot] = note_spans.size();
+			note_spans.push_back({ msg, msg->time, NOTE_SPAN_OPEN });
+		} else {
+			for (uint32_t i = open_head[slot]; i != NOTE_SPAN_OPEN; i = open_next[i]) {
+				note_spans[i].end_msec = msg->time;
+			}
+			open_head[slot] = NOTE_SPAN_OPEN;
+		}
+	}
+
+	// counts first, then the lists. a span is listed at every checkpoint after its start and up to its end
+	uint32_t checkpoint_count = song_msec / NOTE_CHECKPOINT_MSEC + 1;
+	checkpoint_offsets.resize(checkpoint_count + 1);
+	for (uint32_t i = 0; i <= checkpoint_count; i++) {
+		checkpoint_offsets[i] = 0;
+	}
+	for (const NoteSpan &span : note_spans) {
+		uint32_t first = span.start_msec / NOTE_CHECKPOINT_MSEC + 1;
+		uint32_t last = span.end_msec == NOTE_SPAN_OPEN ? checkpoint_count - 1 : MIN((span.end_msec - 1) / NOTE_CHECKPOINT_MSEC, checkpoint_count - 1);
+		for (uint32_t i = first; i <= last; i++) {
+			checkpoint_offsets[i + 1]++;
+		}
+	}
+	for (uint32_t i = 0; i < checkpoint_count; i++) {
+		checkpoint_offsets[i + 1] += checkpoint_offsets[i];
+	}
+
+	checkpoint_spans.resize(checkpoint_offsets[checkpoint_count]);
+	LocalVector<uint32_t> fill;
+	fill.resize(checkpoint_count);
+	for (uint32_t i = 0; i < checkpoint_count; i++) {
+		fill[i] = checkpoint_offsets[i];
+	}
+	for (uint32_t span = 0; span < note_spans.size(); span++) {
+		uint32_t first = note_spans[span].start_msec / NOTE_CHECKPOINT_MSEC + 1;
+		uint32_t end_msec = note_spans[span].end_msec;
+		uint32_t last = end_msec == NOTE_SPAN_OPEN ? checkpoint_count - 1 : MIN((end_msec - 1) / NOTE_CHECKPOINT_MSEC, checkpoint_count - 1);
+		for (uint32_t i = first; i <= last; i++) {
+			checkpoint_spans[fill[i]++] = span;
+		}
+	}
+}
+
+void MIDI::_build_tempo_map() {
+	tempo_map.clear();
+	tempo_map.push_back({ 0.0, 0.0, 500.0 }); // 120 BPM until the first tempo event
+	for (tml_message *msg = midi; msg; msg = msg->next) {
+		int usec_per_beat = msg->type == TML_SET_TEMPO ? tml_get_tempo_value(msg) : 0;
+		if (usec_per_beat <= 0) {
+			continue;
+		}
+		const TempoSegment &last = tempo_map[tempo_map.size() - 1];
+		double beat = last.beat + (msg->time - last.msec) / last.msec_per_beat;
+		if (msg->time == last.msec) {
+			tempo_map[tempo_map.size() - 1].msec_per_beat = usec_per_beat / 1000.0;
+		} else {
+			tempo_map.push_back({ (double)msg->time, beat, usec_per_beat / 1000.0 });
+		}
+	}
+}
+
+double MIDI::get_beat_time(double p_beat) const {
+	if (tempo_map.is_empty()) {
+		return p_beat * 0.5;
+	}
+	// last segment starting at or before the beat
+	uint32_t low = 0;
+	uint32_t high = tempo_map.size();
+	while (high - low > 1) {
+		uint32_t mid = (low + high) / 2;
+		if (tempo_map[mid].beat <= p_beat) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+	const TempoSegment &segment = tempo_map[low];
+	return (segment.msec + (p_beat - segment.beat) * segment.msec_per_beat) / 1000.0;
+}
+
+double MIDI::get_beat_at(double p_time) const {
+	if (tempo_map.is_empty()) {
+		return p_time * 2.0;
+	}
+	double msec = p_time * 1000.0;
+	uint32_t low = 0;
+	uint32_t high = tempo_map.size();
+	while (high - low > 1) {
+		uint32_t mid = (low + high) / 2;
+		if (tempo_map[mid].msec <= msec) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+	const TempoSegment &segment = tempo_map[low];
+	return segment.beat + (msec - segment.msec) / segment.msec_per_beat;
+}
+
+tml_message *MIDI::get_state_before(double p_msec, LocalVector<tml_message *> &r_state) const {
+	LocalVector<tml_message *> last_program;
+	LocalVector<tml_message *> last_pitch_bend;
+	LocalVector<tml_message *> last_control;
+	last_program.resize(channel_count);
+	last_pitch_bend.resize(channel_count);
+	last_control.resize(channel_count * 128);
+	for (int i = 0; i < channel_count; i++) {
+		last_program[i] = nullptr;
+		last_pitch_bend[i] = nullptr;
+	}
+	for (int i = 0; i < channel_count * 128; i++) {
+		last_control[i] = nullptr;
+	}
+
+	tml_message *msg = midi;
+	for (; msg && msg->time < p_msec; msg = msg->next) {
+		if (msg->channel >= channel_count) {
+			continue;
+		}
+		switch (msg->type) {
+			case TML_PROGRAM_CHANGE:
+				last_program[msg->channel] = msg;
+				break;
+			case TML_PITCH_BEND:
+				last_pitch_bend[msg->channel] = msg;
+				break;
+			case TML_CONTROL_CHANGE:
+				last_control[msg->channel * 128 + msg->control] = msg;
+				break;
+			default:
+				break;
+		}
+	}
+	tml_message *end = msg;
+
+	// second pass keeps the file order, a bank select still comes before its program change
+	r_state.clear();
+	for (msg = midi; msg != end; msg = msg->next) {
+		if (msg->channel >= channel_count) {
+			continue;
+		}
+		bool last = (msg->type == TML_PROGRAM_CHANGE && last_program[msg->channel] == msg) ||
+				(msg->type == TML_PITCH_BEND && last_pitch_bend[msg->channel] == msg) ||
+				(msg->type == TML_CONTROL_CHANGE && last_control[msg->channel * 128 + msg->control] == msg);
+		if (last) {
+			r_state.push_back(msg);
+		}
+	}
+	return end;
+}
+
 MIDI::MIDI() {
 	midi = nullptr;
 }
@@ -20,32 +477,110 @@ MIDI::~MIDI() {
 	}
 }
 
+static void _smf_write_track(LocalVector<uint8_t> &r_file, const LocalVector<uint8_t> &p_track) {
+	r_file.push_back('M');
+	r_file.push_back('T');
+	r_file.push_back('r');
+	r_file.push_back('k');
+	_smf_write_be32(r_file, p_track.size());
+	for (uint32_t i = 0; i < p_track.size(); i++) {
+		r_file.push_back(p_track[i]);
+	}
+}
+
+void MIDI::encode_smf(const LocalVector<SMFEvent> &p_events, int p_ticks_per_beat, uint32_t p_usec_per_beat, LocalVector<uint8_t> &r_file) {
+	int port_count = 1;
+	for (uint32_t i = 0; i < p_events.size(); i++) {
+		port_count = MAX(port_count, p_events[i].channel / 16 + 1);
+	}
+
+	r_file.clear();
+	const uint8_t header[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, uint8_t((port_count + 1) >> 8), uint8_t(port_count + 1), uint8_t(p_ticks_per_beat >> 8), uint8_t(p_ticks_per_beat) };
+	for (uint32_t i = 0; i < sizeof(header); i++) {
+		r_file.push_back(header[i]);
+	}
+
+	LocalVector<uint8_t> track;
+	const uint8_t tempo[] = { 0x00, 0xFF, 0x51, 0x03, uint8_t(p_usec_per_beat >> 16), uint8_t(p_usec_per_beat >> 8), uint8_t(p_usec_per_beat), 0x00, 0xFF, 0x2F, 0x00 };
+	for (uint32_t i = 0; i < sizeof(tempo); i++) {
+		track.push_back(tempo[i]);
+	}
+	_smf_write_track(r_file, track);
+
+	// no running status, every message carries its status byte
+	for (int port = 0; port < port_count; port++) {
+		track.clear();
+		const uint8_t port_meta[] = { 0x00, 0xFF, 0x21, 0x01, uint8_t(port) };
+		for (uint32_t i = 0; i < sizeof(port_meta); i++) {
+			track.push_back(port_meta[i]);
+		}
+
+		uint32_t last_tick = 0;
+		for (uint32_t i = 0; i < p_events.size(); i++) {
+			const SMFEvent &event = p_events[i];
+			if (event.channel / 16 != port) {
+				continue;
+			}
+			uint32_t tick = MAX(event.tick, last_tick);
+			_smf_write_vlq(track, tick - last_tick);
+			last_tick = tick;
+
+			track.push_back((event.type & 0xF0) | (event.channel & 0x0F));
+			if (event.type == 0xE0) {
+				track.push_back(event.data1 & 0x7F);
+				track.push_back((event.data1 >> 7) & 0x7F);
+			} else {
+				track.push_back(event.data1 & 0x7F);
+				if (event.type != 0xC0 && event.type != 0xD0) {
+					track.push_back(event.data2 & 0x7F);
+				}
+			}
+		}
+
+		track.push_back(0x00);
+		track.push_back(0xFF);
+		track.push_back(0x2F);
+		track.push_back(0x00);
+		_smf_write_track(r_file, track);
+	}
+}
+
 #ifdef _GDEXTENSION
 void MIDI::_bind_methods() {
 	ClassDB::bind_static_method("MIDI", D_METHOD("load_from_buffer", "data"), &MIDI::load_from_buffer);
+	ClassDB::bind_method(D_METHOD("get_channel_count"), &MIDI::get_channel_count);
+	ClassDB::bind_method(D_METHOD("get_beat_time", "beat"), &MIDI::get_beat_time);
+	ClassDB::bind_method(D_METHOD("get_beat_at", "time"), &MIDI::get_beat_at);
 }
 
 Ref<MIDI> MIDI::load_from_buffer(const PackedByteArray &p_stream_data) {
 	Ref<MIDI> m;
 	m.instantiate();
-	m->midi = tml_load_memory(p_stream_data.ptr(), p_stream_data.size());
+	m->midi = _smf_load(p_stream_data.ptr(), p_stream_data.size(), m->channel_count);
 	if (!m->midi) {
 		ERR_FAIL_V_MSG(Ref<MIDI>(), "Failed to load MIDI from buffer.");
 	}
+	m->_build_note_index();
+	m->_build_tempo_map();
 	return m;
 }
 #else
 void MIDI::_bind_methods() {
 	ClassDB::bind_static_method("MIDI", D_METHOD("load_from_buffer", "data"), &MIDI::load_from_buffer);
+	ClassDB::bind_method(D_METHOD("get_channel_count"), &MIDI::get_channel_count);
+	ClassDB::bind_method(D_METHOD("get_beat_time", "beat"), &MIDI::get_beat_time);
+	ClassDB::bind_method(D_METHOD("get_beat_at", "time"), &MIDI::get_beat_at);
 }
 
 Ref<MIDI> MIDI::load_from_buffer(const Vector<uint8_t> &p_stream_data) {
 	Ref<MIDI> m;
 	m.instantiate();
-	m->midi = tml_load_memory(p_stream_data.ptr(), p_stream_data.size());
+	m->midi = _smf_load(p_stream_data.ptr(), p_stream_data.size(), m->channel_count);
 	if (!m->midi) {
 		ERR_FAIL_V_MSG(Ref<MIDI>(), "Failed to load MIDI from buffer.");
 	}
+	m->_build_note_index();
+	m->_build_tempo_map();
 	return m;
 }
 #endif
@@ -4,10 +4,12 @@
 #include <godot_cpp/classes/resource.hpp>
 #include <godot_cpp/classes/resource_format_loader.hpp>
 #include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
 using namespace godot;
 #else
 #include "core/io/resource.h"
 #include "core/io/resource_loader.h"
+#include "core/templates/local_vector.h"
 #endif
 
 class tml_message;
@@ -17,7 +19,50 @@ class AudioStreamPlaybackMIDISF2;
 class MIDI : public Resource {
 	GDCLASS(MIDI, Resource);
 
+public:
+	// one note of the song, from its note on to the note off that releases it
+	struct NoteSpan {
+		tml_message *note_on;
+		uint32_t start_msec;
+		uint32_t end_msec; // NOTE_SPAN_OPEN if the song never releases it
+	};
+
+	// one channel voice message for encode_smf(), pitch bend as a single 14-bit value in data1
+	struct SMFEvent {
+		uint32_t tick;
+		uint8_t type; // status without the channel
+		uint8_t channel; // 16 per port
+		uint16_t data1;
+		uint8_t data2;
+	};
+
+	static const uint32_t NOTE_SPAN_OPEN = 0xFFFFFFFF;
+	// spacing of the precomputed lists of sounding notes, bounds the scan of get_notes_at()
+	static const uint32_t NOTE_CHECKPOINT_MSEC = 2000;
+
+private:
 	tml_message* midi;
+	int channel_count = 16;
+	uint32_t length_msec = 0; // time of the last message
+
+	// note index for chasing notes on seek, built once on load.
+	// checkpoint i lists the spans that started before i * NOTE_CHECKPOINT_MSEC and still sound there,
+	// as checkpoint_spans[checkpoint_offsets[i] .. checkpoint_offsets[i + 1])
+	LocalVector<NoteSpan> note_spans; // by start time
+	LocalVector<uint32_t> checkpoint_offsets;
+	LocalVector<uint32_t> checkpoint_spans;
+
+	void _build_note_index();
+
+	// tml already converted ticks to milliseconds, this maps beats back onto them
+	struct TempoSegment {
+		double msec;
+		double beat;
+		double msec_per_beat;
+	};
+	LocalVector<TempoSegment> tempo_map; // one segment per tempo change, from 0
+
+	void _build_tempo_map();
 
 	friend class AudioStreamPlaybackMIDISF2;
 
@@ -36,6 +81,121 @@ public:
 		return midi;
 	}
 
+	// 16 per MIDI port used by the file
+	int get_channel_count() const {
+		return channel_count;
+	}
+
+	// song time in seconds of a position in quarter notes, following the tempo changes
+	double get_beat_time(double p_beat) const;
+	// the inverse of get_beat_time()
+	double get_beat_at(double p_time) const;
+
+	uint32_t get_length_msec() const {
+		return length_msec;
+	}
+
+	// calls p_callback(const NoteSpan &) for every note sounding at p_msec: started at or before it
+	// and released after it. costs the notes at one checkpoint plus the ones started since, never allocates
+	template <typename F>
+	void get_notes_at(double p_msec, F p_callback) const {
+		if (note_spans.is_empty() || p_msec < 0.0) {
+			return;
+		}
+		uint32_t checkpoint = MIN((uint32_t)(p_msec / NOTE_CHECKPOINT_MSEC), checkpoint_offsets.size() - 2);
+		uint32_t checkpoint_msec = checkpoint * NOTE_CHECKPOINT_MSEC;
+
+		for (uint32_t i = checkpoint_offsets[checkpoint]; i < checkpoint_offsets[checkpoint + 1]; i++) {
+			const NoteSpan &span = note_spans[checkpoint_spans[i]];
+			if (span.end_msec > p_msec) {
+				p_callback(span);
+			}
+		}
+
+		// first span starting at or after the checkpoint
+		uint32_t low = 0;
+		uint32_t high = note_spans.size();
+		while (low < high) {
+			uint32_t mid = (low + high) / 2;
+			if (note_spans[mid].start_msec < checkpoint_msec) {
+				low = mid + 1;
+			} else {
+				high = mid;
+			}
+		}
+		for (uint32_t i = low; i < note_spans.size() && note_spans[i].start_msec <= p_msec; i++) {
+			if (note_spans[i].end_msec > p_msec) {
+				p_callback(note_spans[i]);
+			}
+		}
+	}
+
+	// the last program, pitch bend and value of each controller of every channel before p_msec, in file order,
+	// replaying them restores the channel state there. returns the first message at or after p_msec
+	tml_message *get_state_before(double p_msec, LocalVector<tml_message *> &r_state) const;
+
+	// writes p_events (in tick order) as a format 1 file at a fixed tempo: a tempo track, then a track per port
+	// up to the highest one used, so channels keep their numbers when the file is loaded back
+	static void encode_smf(const LocalVector<SMFEvent> &p_events, int p_ticks_per_beat, uint32_t p_usec_per_beat, LocalVector<uint8_t> &r_file);
+
+	// decodes a raw MIDI byte stream (running status allowed, system messages skipped)
+	// and calls p_callback(status, channel, data1, data2) for every channel voice message.
+	// pitch bend is delivered as a single 14-bit value in data1.
+	template <typename F>
+	static int decode_raw_messages(const uint8_t *p_data, int p_size, F p_callback) {
+		int count = 0;
+		int status = 0;
+		int i = 0;
+		while (i < p_size) {
+			int byte = p_data[i];
+			if (byte >= 0xF8) {
+				// realtime bytes may appear anywhere and don't affect running status
+				i++;
+				continue;
+			}
+			if (byte >= 0xF0) {
+				status = 0;
+				i++;
+				if (byte == 0xF0) {
+					while (i < p_size && p_data[i] != 0xF7) {
+						i++;
+					}
+					i++;
+				} else if (byte == 0xF1 || byte == 0xF3) {
+					i += 1;
+				} else if (byte == 0xF2) {
+					i += 2;
+				}
+				continue;
+			}
+			if (byte & 0x80) {
+				status = byte;
+				i++;
+			} else if (status == 0) {
+				// stray data byte
+				i++;
+				continue;
+			}
+
+			int type = status & 0xF0;
+			int data_len = (type == 0xC0 || type == 0xD0) ? 1 : 2;
+			if (i + data_len > p_size) {
+				break;
+			}
+			int data1 = p_data[i] & 0x7F;
+			int data2 = data_len > 1 ? (p_data[i + 1] & 0x7F) : 0;
+			i += data_len;
+
+			if (type == 0xE0) {
+				data1 = data1 | (data2 << 7);
+				data2 = 0;
+			}
+			p_callback(type, status & 0x0F, data1, data2);
+			count++;
+		}
+		return count;
+	}
+
 	MIDI();
 	~MIDI();
 };
@@ -0,0 +1,232 @@
+#include "midi_effects.h"
+
+#ifdef _GDEXTENSION
+#include <godot_cpp/core/math.hpp>
+using namespace godot;
+#else
+#include "core/math/math_funcs.h"
+#endif
+
+// freeverb tunings at 44.1 kHz, the right side is offset for stereo spread
+static const int REVERB_COMB_TUNING[MIDIReverb::COMB_COUNT] = { 1116, 1188, 1277, 1356 };
+static const int REVERB_ALLPASS_TUNING[MIDIReverb::ALLPASS_COUNT] = { 556, 441 };
+static const int REVERB_STEREO_SPREAD = 23;
+static const float REVERB_INPUT_GAIN = 0.015f;
+static const float REVERB_WET_GAIN = 3.0f;
+
+static const float CHORUS_DELAY_MSEC = 12.0f;
+static const float CHORUS_DEPTH_MSEC = 3.0f;
+static const float CHORUS_RATE_HZ = 0.4f;
+static const float CHORUS_WET_GAIN = 0.5f;
+
+void MIDIReverb::setup(float p_mix_rate, int p_max_block) {
+	float scale = p_mix_rate / 44100.0f;
+	for (int side = 0; side < 2; side++) {
+		int spread = side * REVERB_STEREO_SPREAD;
+		// at least one block long, so a whole block can be read before any of it is overwritten
+		for (int i = 0; i < COMB_COUNT; i++) {
+			combs[side][i].buffer.resize(MAX((int)((REVERB_COMB_TUNING[i] + spread) * scale), p_max_block));
+		}
+		for (int i = 0; i < ALLPASS_COUNT; i++) {
+			allpasses[side][i].buffer.resize(MAX((int)((REVERB_ALLPASS_TUNING[i] + spread) * scale), p_max_block));
+		}
+	}
+	clear();
+}
+
+void MIDIReverb::clear() {
+	for (int side = 0; side < 2; side++) {
+		for (int i = 0; i < COMB_COUNT; i++) {
+			Comb &comb = combs[side][i];
+			memset(comb.buffer.ptr(), 0, comb.buffer.size() * sizeof(float));
+			comb.pos = 0;
+			comb.store = 0.0f;
+		}
+		for (int i = 0; i < ALLPASS_COUNT; i++) {
+			Allpass &allpass = allpasses[side][i];
+			memset(allpass.buffer.ptr(), 0, allpass.buffer.size() * sizeof(float));
+			allpass.pos = 0;
+		}
+	}
+}
+
+void MIDIReverb::_process_comb(Comb &p_comb, const float *p_in, float *p_out, int p_frames) {
+	uint32_t size = p_comb.buffer.size();
+	float *buffer = p_comb.buffer.ptr();
+	float store = p_comb.store;
+	float damp1 = damp;
+	float damp2 = 1.0f - damp;
+
+	// split at the wrap point so the inner loop runs over contiguous memory
+	int done = 0;
+	while (done < p_frames) {
+		int count = MIN(p_frames - done, (int)(size - p_comb.pos));
+		float *line = buffer + p_comb.pos;
+		for (int i = 0; i < count; i++) {
+			float out = line[i];
+			store = out * damp2 + store * damp1;
+			line[i] = p_in[done + i] + store * feedback;
+			p_out[done + i] += out;
+		}
+		done += count;
+		p_comb.pos += count;
+		if (p_comb.pos == size) {
+			p_comb.pos = 0;
+		}
+	}
+	p_comb.store = store;
+}
+
+void MIDIReverb::_process_allpass(Allpass &p_allpass, float *p_io, int p_frames) {
+	uint32_t size = p_allpass.buffer.size();
+	float *buffer = p_allpass.buffer.ptr();
+
+	int done = 0;
+	while (done < p_frames) {
+		int count = MIN(p_frames - done, (int)(size - p_allpass.pos));
+		float *line = buffer + p_allpass.pos;
+		for (int i = 0; i < count; i++) {
+			float in = p_io[done + i];
+			float delayed = line[i];
+			line[i] = in + delayed * 0.5f;
+			p_io[done + i] = delayed - in;
+		}
+		done += count;
+		p_allpass.pos += count;
+		if (p_allpass.pos == size) {
+			p_allpass.pos = 0;
+		}
+	}
+}
+
+void MIDIReverb::process(const float *p_in, float *p_out, int p_frames) {
+	float in[MIDIEffects::MAX_BLOCK_SIZE];
+	float wet[MIDIEffects::MAX_BLOCK_SIZE];
+	for (int i = 0; i < p_frames; i++) {
+		in[i] = p_in[i] * REVERB_INPUT_GAIN;
+	}
+
+	for (int side = 0; side < 2; side++) {
+		memset(wet, 0, p_frames * sizeof(float));
+		for (int i = 0; i < COMB_COUNT; i++) {
+			_process_comb(combs[side][i], in, wet, p_frames);
+		}
+		for (int i = 0; i < ALLPASS_COUNT; i++) {
+			_process_allpass(allpasses[side][i], wet, p_frames);
+		}
+		for (int i = 0; i < p_frames; i++) {
+			p_out[i * 2 + side] += wet[i] * REVERB_WET_GAIN;
+		}
+	}
+}
+
+void MIDIChorus::setup(float p_mix_rate, int p_max_block) {
+	base_delay = CHORUS_DELAY_MSEC * p_mix_rate / 1000.0f;
+	depth = CHORUS_DEPTH_MSEC * p_mix_rate / 1000.0f;
+	lfo_step = CHORUS_RATE_HZ / p_mix_rate;
+
+	// the longest tap plus the block written ahead of it, rounded up for masking
+	uint32_t needed = (uint32_t)(base_delay + depth) + p_max_block + 2;
+	uint32_t size = 1;
+	while (size < needed) {
+		size <<= 1;
+	}
+	buffer.resize(size);
+	clear();
+}
+
+void MIDIChorus::clear() {
+	memset(buffer.ptr(), 0, buffer.size() * sizeof(float));
+	pos = 0;
+	lfo_phase = 0.0;
+}
+
+void MIDIChorus::process(const float *p_in, float *p_out, int p_frames) {
+	uint32_t mask = buffer.size() - 1;
+	float *line = buffer.ptr();
+	for (int i = 0; i < p_frames; i++) {
+		line[(pos + i) & mask] = p_in[i];
+	}
+
+	// the LFO only moves a fraction of a sample per block, ramp the delays linearly across it
+	double phase_end = lfo_phase + lfo_step * p_frames;
+	float angle_start = (float)(lfo_phase * Math::PI * 2.0);
+	float angle_end = (float)(phase_end * Math::PI * 2.0);
+	float delay_start[2] = { base_delay + depth * Math::sin(angle_start), base_delay + depth * Math::cos(angle_start) };
+	float delay_end[2] = { base_delay + depth * Math::sin(angle_end), base_delay + depth * Math::cos(angle_end) };
+	lfo_phase = phase_end - Math::floor(phase_end);
+
+	for (int side = 0; side < 2; side++) {
+		float delay = delay_start[side];
+		float delay_step = (delay_end[side] - delay_start[side]) / p_frames;
+		for (int i = 0; i < p_frames; i++) {
+			float read = (float)(pos + i) - delay;
+			int index = (int)Math::floor(read);
+			float frac = read - index;
+			float a = line[index & mask];
+			float b = line[(index + 1) & mask];
+			p_out[i * 2 + side] += (a + (b - a) * frac) * CHORUS_WET_GAIN;
+			delay += delay_step;
+		}
+	}
+
+	pos = (pos + p_frames) & mask;
+}
+
+void MIDIEffects::setup(float p_mix_rate) {
+	reverb.setup(p_mix_rate, MAX_BLOCK_SIZE);
+	chorus.setup(p_mix_rate, MAX_BLOCK_SIZE);
+	tail_frames = (int)(TAIL_SECONDS * p_mix_rate);
+	reset();
+}
+
+void MIDIEffects::reset() {
+	clear_sends();
+	if (tail_frames_left > 0) {
+		reverb.clear();
+		chorus.clear();
+		tail_frames_left = 0;
+	}
+}
+
+void MIDIEffects::clear_sends() {
+	for (int i = 0; i < MAX_CHANNELS; i++) {
+		reverb_levels[i] = 0.0f;
+		chorus_levels[i] = 0.0f;
+	}
+	send_channel_count = 0;
+}
+
+void MIDIEffects::control(int p_channel, int p_controller, int p_value) {
+	if (p_channel < 0 || p_channel >= MAX_CHANNELS) {
+		return;
+	}
+
+	float *levels;
+	if (p_controller == 91) {
+		levels = reverb_levels;
+	} else if (p_controller == 93) {
+		levels = chorus_levels;
+	} else {
+		return;
+	}
+
+	bool was_sending = reverb_levels[p_channel] > 0.0f || chorus_levels[p_channel] > 0.0f;
+	levels[p_channel] = CLAMP(p_value, 0, 127) / 127.0f;
+	bool sending = reverb_levels[p_channel] > 0.0f || chorus_levels[p_channel] > 0.0f;
+	send_channel_count += (int)sending - (int)was_sending;
+}
+
+void MIDIEffects::process(float *p_out, int p_frames, bool p_fed) {
+	if (p_fed) {
+		tail_frames_left = tail_frames;
+	} else if (tail_frames_left <= 0) {
+		return;
+	} else {
+		// nothing new came in (the sends are silent), keep the delay lines running until they died out
+		tail_frames_left -= p_frames;
+	}
+
+	reverb.process(reverb_send, p_out, p_frames);
+	chorus.process(chorus_send, p_out, p_frames);
+}
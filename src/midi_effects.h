@@ -0,0 +1,123 @@
+#pragma once
+
+#ifdef _GDEXTENSION
+#include <godot_cpp/templates/local_vector.hpp>
+using namespace godot;
+#else
+#include "core/templates/local_vector.h"
+#endif
+
+#include <stdint.h>
+
+/*
+	shared GM style send effects for one playback: every voice is summed into
+	a mono reverb and chorus send (scaled by its channel's CC91 / CC93 level)
+	and each effect runs once per block on that sum, instead of per voice.
+	delay lines are allocated by setup() on the main thread, process() never allocates.
+*/
+
+// freeverb style: parallel lowpass-feedback combs into series allpasses, per side
+class MIDIReverb {
+public:
+	static const int COMB_COUNT = 4;
+	static const int ALLPASS_COUNT = 2;
+
+private:
+	struct Comb {
+		LocalVector<float> buffer;
+		uint32_t pos = 0;
+		float store = 0.0f;
+	};
+
+	struct Allpass {
+		LocalVector<float> buffer;
+		uint32_t pos = 0;
+	};
+
+	Comb combs[2][COMB_COUNT];
+	Allpass allpasses[2][ALLPASS_COUNT];
+
+	float feedback = 0.84f;
+	float damp = 0.2f;
+
+	void _process_comb(Comb &p_comb, const float *p_in, float *p_out, int p_frames);
+	void _process_allpass(Allpass &p_allpass, float *p_io, int p_frames);
+
+public:
+	// p_max_block is the largest p_frames passed to process(), the delay lines are never shorter
+	void setup(float p_mix_rate, int p_max_block);
+	void clear();
+
+	// adds the wet signal of the mono p_in to the stereo interleaved p_out
+	void process(const float *p_in, float *p_out, int p_frames);
+};
+
+// two taps on one delay line, swept in quadrature by a slow LFO for width
+class MIDIChorus {
+	LocalVector<float> buffer;
+	uint32_t pos = 0;
+	double lfo_phase = 0.0;
+	float lfo_step = 0.0f;
+	float base_delay = 0.0f;
+	float depth = 0.0f;
+
+public:
+	void setup(float p_mix_rate, int p_max_block);
+	void clear();
+
+	void process(const float *p_in, float *p_out, int p_frames);
+};
+
+class MIDIEffects {
+public:
+	static const int MAX_CHANNELS = 256;
+	static const int MAX_BLOCK_SIZE = 64;
+	// how long the effects keep running after the last send input
+	static constexpr float TAIL_SECONDS = 2.0f;
+
+private:
+	MIDIReverb reverb;
+	MIDIChorus chorus;
+
+	float reverb_levels[MAX_CHANNELS] = {};
+	float chorus_levels[MAX_CHANNELS] = {};
+	int send_channel_count = 0;
+
+	int tail_frames = 0;
+	int tail_frames_left = 0;
+
+public:
+	alignas(16) float reverb_send[MAX_BLOCK_SIZE];
+	alignas(16) float chorus_send[MAX_BLOCK_SIZE];
+	alignas(16) float scratch[MAX_BLOCK_SIZE * 2];
+
+	void setup(float p_mix_rate);
+	// drops the send levels and whatever is still ringing
+	void reset();
+	// drops the send levels only, what is ringing dies out on its own
+	void clear_sends();
+
+	// CC91 and CC93, other controllers are ignored
+	void control(int p_channel, int p_controller, int p_value);
+
+	const float *get_reverb_levels() const {
+		return reverb_levels;
+	}
+
+	const float *get_chorus_levels() const {
+		return chorus_levels;
+	}
+
+	// some channel sends something or a tail is still audible
+	bool is_active() const {
+		return send_channel_count > 0 || tail_frames_left > 0;
+	}
+
+	bool has_tail() const {
+		return tail_frames_left > 0;
+	}
+
+	// adds the effect returns to p_out. reverb_send and chorus_send must hold this block's sends,
+	// p_fed tells whether any voice was summed into them
+	void process(float *p_out, int p_frames, bool p_fed);
+};
@@ -0,0 +1,355 @@
+#include "midi_input_router.h"
+
+#ifdef _GDEXTENSION
+#include <godot_cpp/classes/audio_stream_player.hpp>
+#include <godot_cpp/classes/audio_stream_player2d.hpp>
+#include <godot_cpp/classes/audio_stream_player3d.hpp>
+#include <godot_cpp/classes/viewport.hpp>
+#include <godot_cpp/core/object.hpp>
+using namespace godot;
+#else
+#include "core/object/class_db.h"
+#include "scene/2d/audio_stream_player_2d.h"
+#include "scene/audio/audio_stream_player.h"
+#include "scene/main/viewport.h"
+#ifndef _3D_DISABLED
+#include "scene/3d/audio_stream_player_3d.h"
+#endif
+#endif
+
+#include "audio_stream_midi.h"
+#include "audio_stream_soundfont_player.h"
+
+void MIDIInputRouter::_notification(int p_what) {
+	switch (p_what) {
+		case NOTIFICATION_READY: {
+			set_process_input(true);
+		} break;
+		case NOTIFICATION_EXIT_TREE: {
+			// a relative path may point somewhere else once the router is back in a tree
+			player_id = 0;
+		} break;
+	}
+}
+
+// false if p_object isn't a T. the playback is only asked for while playing, that errors otherwise
+template <class T>
+static bool _get_player_playback(Object *p_object, Ref<AudioStreamPlayback> &r_playback) {
+	T *player = Object::cast_to<T>(p_object);
+	if (!player) {
+		return false;
+	}
+	if (player->is_playing()) {
+		r_playback = player->get_stream_playback();
+	}
+	return true;
+}
+
+#ifdef _GDEXTENSION
+void MIDIInputRouter::_input(const Ref<InputEvent> &p_event) {
+#else
+void MIDIInputRouter::input(const Ref<InputEvent> &p_event) {
+#endif
+	if (route_midi_event(p_event) && consume_events) {
+		get_viewport()->set_input_as_handled();
+	}
+}
+
+Object *MIDIInputRouter::_get_player_node() {
+#ifdef _GDEXTENSION
+	Object *node = player_id ? ObjectDB::get_instance(player_id) : nullptr;
+#else
+	Object *node = player_id ? ObjectDB::get_instance(ObjectID(player_id)) : nullptr;
+#endif
+	if (node) {
+		return node;
+	}
+	if (player.is_empty() || !is_inside_tree()) {
+		return nullptr;
+	}
+	node = get_node_or_null(player);
+	player_id = node ? (uint64_t)node->get_instance_id() : 0;
+	return node;
+}
+
+Ref<AudioStreamPlayback> MIDIInputRouter::_get_target_playback() {
+	if (playback.is_valid()) {
+		return playback;
+	}
+	Object *node = _get_player_node();
+	if (!node) {
+		return Ref<AudioStreamPlayback>();
+	}
+	// a new playback comes with every play(), so it's fetched each time, but with typed calls
+	Ref<AudioStreamPlayback> result;
+	if (_get_player_playback<AudioStreamPlayer>(node, result) || _get_player_playback<AudioStreamPlayer2D>(node, result)) {
+		return result;
+	}
+#if defined(_GDEXTENSION) || !defined(_3D_DISABLED)
+	_get_player_playback<AudioStreamPlayer3D>(node, result);
+#endif
+	return result;
+}
+
+const MIDIInputRouter::Route *MIDIInputRouter::_find_route(int p_device, int p_channel) const {
+	// the most specific match: device and channel, then the device, then the channel on any device
+	const Route *best = nullptr;
+	int best_rank = -1;
+	for (const Route &route : routes) {
+		if ((route.device != -1 && route.device != p_device) || (route.channel != -1 && route.channel != p_channel)) {
+			continue;
+		}
+		int rank = (route.device != -1 ? 2 : 0) + (route.channel != -1 ? 1 : 0);
+		if (rank > best_rank) {
+			best = &route;
+			best_rank = rank;
+		}
+	}
+	return best;
+}
+
+bool MIDIInputRouter::translate_event(const Ref<InputEvent> &p_event, RoutedMessage &r_message) {
+	const InputEventMIDI *event = Object::cast_to<InputEventMIDI>(p_event.ptr());
+	if (!event) {
+		return false;
+	}
+	int channel = event->get_channel();
+	if (channel < 0 || channel > 15) {
+		return false;
+	}
+	int target_channel = channel;
+	const Route *route = _find_route(event->get_device(), channel);
+	if (route) {
+		if (route->output_channel == OUTPUT_DROP) {
+			return false;
+		}
+		if (route->output_channel != OUTPUT_KEEP) {
+			target_channel = route->output_channel;
+		}
+	} else {
+		if ((device >= 0 && event->get_device() != device) || !(channel_mask & (1 << channel))) {
+			return false;
+		}
+		if (output_channel >= 0) {
+			target_channel = output_channel;
+		}
+	}
+
+	// the MIDIMessage values are the status nibble
+	int status = (int)event->get_message() << 4;
+	int param1 = 0;
+	int param2 = 0;
+	switch (status) {
+		case AudioStreamPlaybackMIDISF2::MESSAGE_NOTE_OFF:
+		case AudioStreamPlaybackMIDISF2::MESSAGE_NOTE_ON:
+			param1 = event->get_pitch();
+			param2 = event->get_velocity();
+			break;
+		case AudioStreamPlaybackMIDISF2::MESSAGE_KEY_PRESSURE:
+			param1 = event->get_pitch();
+			param2 = event->get_pressure();
+			break;
+		case AudioStreamPlaybackMIDISF2::MESSAGE_CONTROL_CHANGE:
+			param1 = event->get_controller_number();
+			param2 = event->get_controller_value();
+			break;
+		case AudioStreamPlaybackMIDISF2::MESSAGE_PROGRAM_CHANGE:
+			param1 = event->get_instrument();
+			break;
+		case AudioStreamPlaybackMIDISF2::MESSAGE_CHANNEL_PRESSURE:
+			param1 = event->get_pressure();
+			break;
+		case AudioStreamPlaybackMIDISF2::MESSAGE_PITCH_BEND:
+			param1 = event->get_pitch(); // 14 bits
+			break;
+		default:
+			// system messages have no channel
+			return false;
+	}
+
+	if (filter.is_valid() && !(bool)filter.call(p_event)) {
+		return false;
+	}
+
+	r_message = { status, target_channel, param1, param2 };
+	return true;
+}
+
+bool MIDIInputRouter::route_midi_event(const Ref<InputEvent> &p_event) {
+	RoutedMessage message;
+	if (!translate_event(p_event, message)) {
+		return false;
+	}
+
+	Ref<AudioStreamPlayback> target = _get_target_playback();
+	if (target.is_null()) {
+		return false;
+	}
+
+	if (AudioStreamPlaybackSoundfont *sf = Object::cast_to<AudioStreamPlaybackSoundfont>(target.ptr())) {
+		sf->push_midi_message(message.type, message.channel, message.param1, message.param2);
+		return true;
+	}
+	if (AudioStreamPlaybackMIDISF2 *midi = Object::cast_to<AudioStreamPlaybackMIDISF2>(target.ptr())) {
+		midi->push_midi_message((AudioStreamPlaybackMIDISF2::MIDIMessageType)message.type, message.channel, message.param1, message.param2);
+		return true;
+	}
+	return false;
+}
+
+void MIDIInputRouter::set_route(int p_device, int p_channel, int p_output_channel) {
+	ERR_FAIL_COND(p_device < -1);
+	ERR_FAIL_COND(p_channel < -1 || p_channel > 15);
+	ERR_FAIL_COND(p_output_channel < OUTPUT_DROP || p_output_channel > MAX_OUTPUT_CHANNEL);
+	for (Route &route : routes) {
+		if (route.device == p_device && route.channel == p_channel) {
+			route.output_channel = p_output_channel;
+			return;
+		}
+	}
+	routes.push_back({ p_device, p_channel, p_output_channel });
+}
+
+void MIDIInputRouter::remove_route(int p_device, int p_channel) {
+	for (uint32_t i = 0; i < routes.size(); i++) {
+		if (routes[i].device == p_device && routes[i].channel == p_channel) {
+			routes.remove_at(i);
+			return;
+		}
+	}
+}
+
+bool MIDIInputRouter::has_route(int p_device, int p_channel) const {
+	for (const Route &route : routes) {
+		if (route.device == p_device && route.channel == p_channel) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void MIDIInputRouter::clear_routes() {
+	routes.clear();
+}
+
+void MIDIInputRouter::set_player(const NodePath &p_player) {
+	player = p_player;
+	player_id = 0;
+}
+
+NodePath MIDIInputRouter::get_player() const {
+	return player;
+}
+
+void MIDIInputRouter::set_playback(const Ref<AudioStreamPlayback> &p_playback) {
+	playback = p_playback;
+}
+
+Ref<AudioStreamPlayback> MIDIInputRouter::get_playback() const {
+	return playback;
+}
+
+void MIDIInputRouter::set_device(int p_device) {
+	device = p_device;
+}
+
+int MIDIInputRouter::get_device() const {
+	return device;
+}
+
+void MIDIInputRouter::set_channel_mask(int p_mask) {
+	channel_mask = p_mask & ALL_CHANNELS;
+}
+
+int MIDIInputRouter::get_channel_mask() const {
+	return channel_mask;
+}
+
+void MIDIInputRouter::set_channel_enabled(int p_channel, bool p_enabled) {
+	ERR_FAIL_INDEX(p_channel, 16);
+	if (p_enabled) {
+		channel_mask |= 1 << p_channel;
+	} else {
+		channel_mask &= ~(1 << p_channel);
+	}
+}
+
+bool MIDIInputRouter::is_channel_enabled(int p_channel) const {
+	ERR_FAIL_INDEX_V(p_channel, 16, false);
+	return channel_mask & (1 << p_channel);
+}
+
+void MIDIInputRouter::set_output_channel(int p_channel) {
+	ERR_FAIL_COND(p_channel < -1 || p_channel > MAX_OUTPUT_CHANNEL);
+	output_channel = p_channel;
+}
+
+int MIDIInputRouter::get_output_channel() const {
+	return output_channel;
+}
+
+void MIDIInputRouter::set_filter(const Callable &p_filter) {
+	filter = p_filter;
+}
+
+Callable MIDIInputRouter::get_filter() const {
+	return filter;
+}
+
+void MIDIInputRouter::set_consume_events(bool p_consume) {
+	consume_events = p_consume;
+}
+
+bool MIDIInputRouter::is_consuming_events() const {
+	return consume_events;
+}
+
+void MIDIInputRouter::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("route_midi_event", "event"), &MIDIInputRouter::route_midi_event);
+
+	ClassDB::bind_method(D_METHOD("set_route", "device", "channel", "output_channel"), &MIDIInputRouter::set_route);
+	ClassDB::bind_method(D_METHOD("remove_route", "device", "channel"), &MIDIInputRouter::remove_route);
+	ClassDB::bind_method(D_METHOD("has_route", "device", "channel"), &MIDIInputRouter::has_route);
+	ClassDB::bind_method(D_METHOD("clear_routes"), &MIDIInputRouter::clear_routes);
+
+	ClassDB::bind_method(D_METHOD("set_player", "player"), &MIDIInputRouter::set_player);
+	ClassDB::bind_method(D_METHOD("get_player"), &MIDIInputRouter::get_player);
+
+	ClassDB::bind_method(D_METHOD("set_playback", "playback"), &MIDIInputRouter::set_playback);
+	ClassDB::bind_method(D_METHOD("get_playback"), &MIDIInputRouter::get_playback);
+
+	ClassDB::bind_method(D_METHOD("set_device", "device"), &MIDIInputRouter::set_device);
+	ClassDB::bind_method(D_METHOD("get_device"), &MIDIInputRouter::get_device);
+
+	ClassDB::bind_method(D_METHOD("set_channel_mask", "mask"), &MIDIInputRouter::set_channel_mask);
+	ClassDB::bind_method(D_METHOD("get_channel_mask"), &MIDIInputRouter::get_channel_mask);
+
+	ClassDB::bind_method(D_METHOD("set_channel_enabled", "channel", "enabled"), &MIDIInputRouter::set_channel_enabled);
+	ClassDB::bind_method(D_METHOD("is_channel_enabled", "channel"), &MIDIInputRouter::is_channel_enabled);
+
+	ClassDB::bind_method(D_METHOD("set_output_channel", "channel"), &MIDIInputRouter::set_output_channel);
+	ClassDB::bind_method(D_METHOD("get_output_channel"), &MIDIInputRouter::get_output_channel);
+
+	ClassDB::bind_method(D_METHOD("set_filter", "filter"), &MIDIInputRouter::set_filter);
+	ClassDB::bind_method(D_METHOD("get_filter"), &MIDIInputRouter::get_filter);
+
+	ClassDB::bind_method(D_METHOD("set_consume_events", "consume"), &MIDIInputRouter::set_consume_events);
+	ClassDB::bind_method(D_METHOD("is_consuming_events"), &MIDIInputRouter::is_consuming_events);
+
+	ADD_PROPERTY(PropertyInfo(Variant::NODE_PATH, "player", PROPERTY_HINT_NODE_PATH_VALID_TYPES, "AudioStreamPlayer,AudioStreamPlayer2D,AudioStreamPlayer3D"), "set_player", "get_player");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "device", PROPERTY_HINT_RANGE, "-1,64,1,or_greater"), "set_device", "get_device");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "channel_mask", PROPERTY_HINT_FLAGS, "1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16"), "set_channel_mask", "get_channel_mask");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "output_channel", PROPERTY_HINT_RANGE, "-1,255,1"), "set_output_channel", "get_output_channel");
+	ADD_PROPERTY(PropertyInfo(Variant::CALLABLE, "filter", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NONE), "set_filter", "get_filter");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "consume_events"), "set_consume_events", "is_consuming_events");
+
+	BIND_CONSTANT(ALL_CHANNELS);
+	BIND_CONSTANT(OUTPUT_KEEP);
+	BIND_CONSTANT(OUTPUT_DROP);
+}
+
+MIDIInputRouter::MIDIInputRouter() {
+}
+
+MIDIInputRouter::~MIDIInputRouter() {
+}
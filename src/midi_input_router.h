@@ -0,0 +1,117 @@
+#pragma once
+
+#ifdef _GDEXTENSION
+#include <godot_cpp/classes/audio_stream_playback.hpp>
+#include <godot_cpp/classes/input_event.hpp>
+#include <godot_cpp/classes/input_event_midi.hpp>
+#include <godot_cpp/classes/node.hpp>
+#include <godot_cpp/templates/local_vector.hpp>
+#include <godot_cpp/variant/callable.hpp>
+#include <godot_cpp/variant/node_path.hpp>
+using namespace godot;
+#else
+#include "core/input/input_event.h"
+#include "core/templates/local_vector.h"
+#include "scene/main/node.h"
+#include "servers/audio/audio_stream.h"
+#endif
+
+/*
+	forwards InputEventMIDI from hardware straight into a synthesizer playback's command queue,
+	without a script in between. events are mapped by a per device and channel route table, or
+	filtered by device and channel when no route matches, then by an optional Callable, and go
+	to an AudioStreamPlaybackSoundfont or to the live input of an AudioStreamPlaybackMIDISF2.
+	the player node is looked up once and its playback fetched with typed calls, so a routed
+	event costs no Variant call unless a filter is set.
+*/
+
+class MIDIInputRouter : public Node {
+	GDCLASS(MIDIInputRouter, Node);
+
+public:
+	static const int ALL_CHANNELS = 0xFFFF;
+	// output channel of a route
+	static const int OUTPUT_KEEP = -1;
+	static const int OUTPUT_DROP = -2;
+	// the playbacks check the channel against their own channel count
+	static const int MAX_OUTPUT_CHANNEL = 255;
+
+	// an event as it is queued on the playback, see AudioStreamPlaybackMIDISF2::push_midi_message
+	struct RoutedMessage {
+		int type;
+		int channel;
+		int param1;
+		int param2;
+	};
+
+private:
+	struct Route {
+		int device; // -1 = any
+		int channel; // -1 = any
+		int output_channel; // a channel, OUTPUT_KEEP or OUTPUT_DROP
+	};
+
+	NodePath player;
+	Ref<AudioStreamPlayback> playback; // overrides player when set
+	int device = -1; // -1 = any
+	int channel_mask = ALL_CHANNELS;
+	int output_channel = -1; // -1 = keep the event's channel
+	LocalVector<Route> routes;
+	Callable filter;
+	bool consume_events = false;
+
+	// the node at player, resolved on first use and whenever the path or the tree changes
+	uint64_t player_id = 0;
+
+	const Route *_find_route(int p_device, int p_channel) const;
+	Object *_get_player_node();
+	Ref<AudioStreamPlayback> _get_target_playback();
+
+protected:
+	void _notification(int p_what);
+#ifndef _GDEXTENSION
+	virtual void input(const Ref<InputEvent> &p_event) override;
+#endif
+	static void _bind_methods();
+
+public:
+#ifdef _GDEXTENSION
+	virtual void _input(const Ref<InputEvent> &p_event) override;
+#endif
+
+	bool route_midi_event(const Ref<InputEvent> &p_event);
+	// the message route_midi_event would queue, false if the event is dropped. the target isn't needed
+	bool translate_event(const Ref<InputEvent> &p_event, RoutedMessage &r_message);
+
+	void set_route(int p_device, int p_channel, int p_output_channel);
+	void remove_route(int p_device, int p_channel);
+	bool has_route(int p_device, int p_channel) const;
+	void clear_routes();
+
+	void set_player(const NodePath &p_player);
+	NodePath get_player() const;
+
+	void set_playback(const Ref<AudioStreamPlayback> &p_playback);
+	Ref<AudioStreamPlayback> get_playback() const;
+
+	void set_device(int p_device);
+	int get_device() const;
+
+	void set_channel_mask(int p_mask);
+	int get_channel_mask() const;
+
+	void set_channel_enabled(int p_channel, bool p_enabled);
+	bool is_channel_enabled(int p_channel) const;
+
+	void set_output_channel(int p_channel);
+	int get_output_channel() const;
+
+	void set_filter(const Callable &p_filter);
+	Callable get_filter() const;
+
+	void set_consume_events(bool p_consume);
+	bool is_consuming_events() const;
+
+	MIDIInputRouter();
+	~MIDIInputRouter();
+};
@@ -0,0 +1,103 @@
+#include "midi_recorder.h"
+
+#ifdef _GDEXTENSION
+using namespace godot;
+#else
+#include "core/error/error_macros.h"
+#endif
+
+void MIDIRecorder::_drain() {
+	Event event;
+	while (ring.pop(event)) {
+		// pushed by a mix that checked the flag before the last start
+		if (event.frame < origin) {
+			continue;
+		}
+		events.push_back(event);
+	}
+}
+
+void MIDIRecorder::start(int p_capacity, float p_mix_rate) {
+	ERR_FAIL_COND(p_capacity < 1);
+	if (ring.capacity() == 0) {
+		// the audio thread doesn't touch the ring before the flag is first set
+		ring.resize(p_capacity);
+	}
+	recording.clear();
+	ring.clear();
+	events.clear();
+	dropped_count.set(0);
+	mix_rate = p_mix_rate;
+	// messages pushed from now on are applied by the next mix
+	origin = clock.get();
+	recording.set();
+}
+
+void MIDIRecorder::stop() {
+	if (!recording.is_set()) {
+		return;
+	}
+	recording.clear();
+	end_frame = clock.get();
+	_drain();
+}
+
+bool MIDIRecorder::is_recording() const {
+	return recording.is_set();
+}
+
+int MIDIRecorder::get_dropped_count() const {
+	return dropped_count.get();
+}
+
+PackedByteArray MIDIRecorder::get_smf() {
+	_drain();
+	uint64_t end = recording.is_set() ? clock.get() : end_frame;
+	double ticks_per_frame = (1000000.0 / USEC_PER_BEAT) * TICKS_PER_BEAT / mix_rate;
+
+	// notes still held at the end are released there, the file would otherwise leave them sounding
+	LocalVector<uint8_t> held;
+	held.resize(256 * 128);
+	memset(held.ptr(), 0, held.size());
+
+	LocalVector<MIDI::SMFEvent> smf_events;
+	smf_events.reserve(events.size());
+	uint32_t tick = 0;
+	for (uint32_t i = 0; i < events.size(); i++) {
+		const Event &event = events[i];
+		tick = (uint32_t)((event.frame - origin) * ticks_per_frame);
+		smf_events.push_back({ tick, event.type, event.channel, event.data1, event.data2 });
+
+		uint8_t *keys = &held[event.channel * 128];
+		if (event.type == 0x90 && event.data2 > 0) {
+			keys[event.data1 & 0x7F] = 1;
+		} else if (event.type == 0x80 || event.type == 0x90) {
+			keys[event.data1 & 0x7F] = 0;
+		} else if (event.type == 0xB0 && (event.data1 == 120 || event.data1 == 123)) {
+			memset(keys, 0, 128);
+		}
+	}
+
+	if (end > origin) {
+		tick = MAX(tick, (uint32_t)((end - origin) * ticks_per_frame));
+	}
+	for (int channel = 0; channel < 256; channel++) {
+		for (int key = 0; key < 128; key++) {
+			if (held[channel * 128 + key]) {
+				smf_events.push_back({ tick, 0x80, uint8_t(channel), uint16_t(key), 0 });
+			}
+		}
+	}
+
+	LocalVector<uint8_t> file;
+	MIDI::encode_smf(smf_events, TICKS_PER_BEAT, USEC_PER_BEAT, file);
+
+	PackedByteArray result;
+	result.resize(file.size());
+	memcpy(result.ptrw(), file.ptr(), file.size());
+	return result;
+}
+
+Ref<MIDI> MIDIRecorder::get_midi() {
+	return MIDI::load_from_buffer(get_smf());
+}
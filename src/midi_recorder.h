@@ -0,0 +1,80 @@
+#pragma once
+
+#ifdef _GDEXTENSION
+#include <godot_cpp/templates/local_vector.hpp>
+#include <godot_cpp/templates/safe_refcount.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+using namespace godot;
+#else
+#include "core/templates/local_vector.h"
+#include "core/templates/safe_refcount.h"
+#endif
+
+#include "lock_free_ring_buffer.h"
+#include "midi.h"
+
+/*
+	records the channel messages a playback applies, so live playing can be kept as a MIDI resource.
+	the audio thread stamps each message with the frame it took effect at and pushes it into a ring
+	allocated by the first start(), record() never allocates or locks and is a flag check while idle.
+	the main thread drains the ring into its own list and turns frames into ticks when exporting.
+*/
+
+class MIDIRecorder {
+public:
+	static const int DEFAULT_CAPACITY = 65536;
+	// exported at 120 BPM, a tick is 1 / 1920 s
+	static const int TICKS_PER_BEAT = 960;
+	static const uint32_t USEC_PER_BEAT = 500000;
+
+private:
+	struct Event {
+		uint64_t frame;
+		uint8_t type;
+		uint8_t channel;
+		uint16_t data1;
+		uint8_t data2;
+	};
+
+	LockFreeRingBuffer<Event> ring;
+	SafeFlag recording;
+	SafeNumeric<uint64_t> clock; // frame the next mix starts at
+	SafeNumeric<uint32_t> dropped_count;
+
+	// main thread
+	LocalVector<Event> events;
+	uint64_t origin = 0;
+	uint64_t end_frame = 0; // where notes still held are released on export, while stopped
+	float mix_rate = 44100.0f;
+
+	void _drain();
+
+public:
+	// audio thread side
+
+	// pitch bend as a single 14-bit value in p_data1, system messages are ignored
+	void record(uint64_t p_frame, int p_type, int p_channel, int p_data1, int p_data2) {
+		if (!recording.is_set() || p_type < 0x80 || p_type > 0xE0 || p_channel < 0 || p_channel > 255) {
+			return;
+		}
+		Event event = { p_frame, uint8_t(p_type), uint8_t(p_channel), uint16_t(p_data1), uint8_t(p_data2) };
+		if (!ring.push(event)) {
+			dropped_count.increment();
+		}
+	}
+
+	void set_clock(uint64_t p_frame) {
+		clock.set(p_frame);
+	}
+
+	// main thread side
+
+	// the ring keeps the capacity of the first start, later ones only clear it
+	void start(int p_capacity, float p_mix_rate);
+	void stop();
+	bool is_recording() const;
+	int get_dropped_count() const;
+
+	PackedByteArray get_smf();
+	Ref<MIDI> get_midi();
+};
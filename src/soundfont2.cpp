@@ -12,7 +12,7 @@ using namespace godot;
 #include "core/io/file_access.h"
 
 #endif
-#include "tsf_impl.h"
+#include "../thirdparty/tinysoundfont/tsf.h"
 
 SoundFont2::SoundFont2() {
 	soundfont = nullptr;
@@ -5,6 +5,8 @@ using namespace godot;
 #include "core/os/memory.h"
 #endif
 
+#include "audio_thread_guard.h"
+
 inline void tml_memfree(void* p_ptr) {
 	// avoiding godot error when pointer is null
 	if (!p_ptr) {
@@ -13,11 +15,27 @@ inline void tml_memfree(void* p_ptr) {
 	memfree(p_ptr);
 }
 
+#ifdef MIDI_TRACK_AUDIO_THREAD_ALLOCATIONS
+inline void tml_tracked_memfree(void* p_ptr) {
+	if (!p_ptr) {
+		return;
+	}
+	audio_thread_guard_free(p_ptr);
+}
+#endif
+
 // use godot memory allocator
 #define TML_NO_STDIO
+#ifdef MIDI_TRACK_AUDIO_THREAD_ALLOCATIONS
+// debug builds report allocations made from the mix thread
+#define TML_MALLOC audio_thread_guard_malloc
+#define TML_REALLOC audio_thread_guard_realloc
+#define TML_FREE tml_tracked_memfree
+#else
 #define TML_MALLOC memalloc
 #define TML_REALLOC memrealloc
 #define TML_FREE tml_memfree
+#endif
 #define TML_MEMCPY memcpy
 
 #define TML_IMPLEMENTATION
@@ -0,0 +1,424 @@
+#include "tsf_ext.h"
+
+#include "tsf_impl.h"
+
+void tsf_ext_reserve_channels(tsf *p_tsf, int p_count) {
+	if (p_count <= 0) {
+		return;
+	}
+	tsf_channel_init(p_tsf, p_count - 1);
+}
+
+void tsf_ext_reset(tsf *p_tsf) {
+	struct tsf_voice *v = p_tsf->voices, *v_end = v + p_tsf->voiceNum;
+	for (; v != v_end; v++) {
+		if (v->playingPreset != -1 && (v->ampenv.segment < TSF_SEGMENT_RELEASE || v->ampenv.parameters.release)) {
+			tsf_voice_endquick(p_tsf, v);
+		}
+	}
+
+	tsf_ext_reset_channels(p_tsf);
+}
+
+void tsf_ext_kill_voices(tsf *p_tsf) {
+	struct tsf_voice *v = p_tsf->voices, *v_end = v + p_tsf->voiceNum;
+	for (; v != v_end; v++) {
+		if (v->playingPreset != -1) {
+			tsf_voice_kill(v);
+		}
+	}
+}
+
+void tsf_ext_reset_channels(tsf *p_tsf) {
+	if (!p_tsf->channels) {
+		return;
+	}
+
+	// same defaults as tsf_channel_init
+	p_tsf->channels->activeChannel = 0;
+	for (int i = 0; i < p_tsf->channels->channelNum; i++) {
+		struct tsf_channel *c = &p_tsf->channels->channels[i];
+		c->presetIndex = c->bank = 0;
+		c->pitchWheel = c->midiPan = 8192;
+		c->midiVolume = c->midiExpression = 16383;
+		c->midiRPN = 0xFFFF;
+		c->midiData = 0;
+		c->panOffset = 0.0f;
+		c->gainDB = 0.0f;
+		c->pitchRange = 2.0f;
+		c->tuning = 0.0f;
+	}
+}
+
+int tsf_ext_cull_voices(tsf *p_tsf, float p_min_gain) {
+	int culled = 0;
+	struct tsf_voice *v = p_tsf->voices, *v_end = v + p_tsf->voiceNum;
+	for (; v != v_end; v++) {
+		// delay, attack and hold still rise, decay and sustain only get quieter unless a controller changes
+		if (v->playingPreset == -1 || v->ampenv.segment < TSF_SEGMENT_DECAY) {
+			continue;
+		}
+		// noteGainDB already follows the channel's CC7 / CC11 and gain
+		float pan = v->panFactorLeft > v->panFactorRight ? v->panFactorLeft : v->panFactorRight;
+		float gain = tsf_decibelsToGain(v->noteGainDB) * v->ampenv.level * pan;
+		if (gain < p_min_gain) {
+			tsf_voice_kill(v);
+			culled++;
+		}
+	}
+	return culled;
+}
+
+// the note that started first, preferring notes already in their release. false if no voice plays
+static bool tsf_ext_find_oldest_note(tsf *p_tsf, unsigned int *r_play_index) {
+	bool found = false;
+	bool found_released = false;
+	unsigned int oldest_age = 0;
+	struct tsf_voice *v = p_tsf->voices, *v_end = v + p_tsf->voiceNum;
+	for (; v != v_end; v++) {
+		if (v->playingPreset == -1) {
+			continue;
+		}
+		bool released = v->ampenv.segment >= TSF_SEGMENT_RELEASE;
+		// distance from the next play index, so the order survives the counter wrapping
+		unsigned int age = p_tsf->voicePlayIndex - v->playIndex;
+		if (!found || (released && !found_released) || (released == found_released && age > oldest_age)) {
+			found = true;
+			found_released = released;
+			oldest_age = age;
+			*r_play_index = v->playIndex;
+		}
+	}
+	return found;
+}
+
+// tsf_note_on returns 1 whether or not a region matched and a voice was free
+static bool tsf_ext_has_play_index(tsf *p_tsf, unsigned int p_play_index) {
+	struct tsf_voice *v = p_tsf->voices, *v_end = v + p_tsf->voiceNum;
+	for (; v != v_end; v++) {
+		if (v->playingPreset != -1 && v->playIndex == p_play_index) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int tsf_ext_note_on_stealing(tsf *p_tsf, int p_channel, int p_preset_index, int p_key, float p_vel, unsigned int *r_play_index) {
+	if (p_preset_index < 0 || p_preset_index >= p_tsf->presetNum) {
+		return -1;
+	}
+	if (!p_tsf->channels || p_channel < 0 || p_channel >= p_tsf->channels->channelNum) {
+		return -1;
+	}
+
+	int stolen = 0;
+	if (p_tsf->maxVoiceNum) {
+		// same region match as tsf_note_on
+		struct tsf_preset *preset = &p_tsf->presets[p_preset_index];
+		int midi_velocity = (int)(p_vel * 127);
+		int needed = 0;
+		for (int i = 0; i < preset->regionNum; i++) {
+			struct tsf_region *region = &preset->regions[i];
+			if (p_key >= region->lokey && p_key <= region->hikey && midi_velocity >= region->lovel && midi_velocity <= region->hivel) {
+				needed++;
+			}
+		}
+		needed = needed < p_tsf->maxVoiceNum ? needed : p_tsf->maxVoiceNum;
+
+		int free_count = p_tsf->voiceNum - tsf_active_voice_count(p_tsf);
+		unsigned int victim;
+		while (free_count < needed && tsf_ext_find_oldest_note(p_tsf, &victim)) {
+			struct tsf_voice *v = p_tsf->voices, *v_end = v + p_tsf->voiceNum;
+			for (; v != v_end; v++) {
+				if (v->playingPreset != -1 && v->playIndex == victim) {
+					tsf_voice_kill(v);
+					free_count++;
+					stolen++;
+				}
+			}
+		}
+	}
+
+	// tsf_note_on sets the voices up with the active channel's controllers, with any preset
+	p_tsf->channels->activeChannel = p_channel;
+
+	// every voice started by one note on shares the play index
+	unsigned int play_index = p_tsf->voicePlayIndex;
+	if (!tsf_note_on(p_tsf, p_preset_index, p_key, p_vel) || !tsf_ext_has_play_index(p_tsf, play_index)) {
+		return -1;
+	}
+	*r_play_index = play_index;
+	return stolen;
+}
+
+void tsf_ext_note_off_play_index(tsf *p_tsf, unsigned int p_play_index) {
+	struct tsf_voice *v = p_tsf->voices, *v_end = v + p_tsf->voiceNum;
+	for (; v != v_end; v++) {
+		if (v->playingPreset != -1 && v->playIndex == p_play_index && v->ampenv.segment < TSF_SEGMENT_RELEASE) {
+			tsf_voice_end(p_tsf, v);
+		}
+	}
+}
+
+// tsf_voice_envelope_process moves on by at most one segment per call, feed it one segment at a time
+static void tsf_ext_envelope_skip(struct tsf_voice_envelope *e, int p_samples, float p_sample_rate) {
+	while (p_samples > 0 && e->segment != TSF_SEGMENT_DONE) {
+		int count = (e->samplesUntilNextSegment > 0 && e->samplesUntilNextSegment < p_samples) ? e->samplesUntilNextSegment : p_samples;
+		tsf_voice_envelope_process(e, count, p_sample_rate);
+		p_samples -= count;
+	}
+}
+
+static void tsf_ext_voice_skip(struct tsf_voice *v, int p_samples, float p_sample_rate) {
+	struct tsf_region *region = v->region;
+
+	tsf_ext_envelope_skip(&v->ampenv, p_samples, p_sample_rate);
+	if (v->ampenv.segment == TSF_SEGMENT_DONE) {
+		tsf_voice_kill(v);
+		return;
+	}
+	tsf_ext_envelope_skip(&v->modenv, p_samples, p_sample_rate);
+	// LFOs only leave their delay, the phase they'd have by now is not worth reconstructing
+	v->modlfo.samplesUntil = v->modlfo.samplesUntil > p_samples ? v->modlfo.samplesUntil - p_samples : 0;
+	v->viblfo.samplesUntil = v->viblfo.samplesUntil > p_samples ? v->viblfo.samplesUntil - p_samples : 0;
+
+	// at the unmodulated pitch, pitch wheel included
+	double position = v->sourceSamplePosition + p_samples * tsf_timecents2Secsd(v->pitchInputTimecents) * v->pitchOutputFactor;
+	bool looping = v->loopStart < v->loopEnd;
+	if (looping && position >= v->loopEnd + 1.0) {
+		double loop_length = v->loopEnd - v->loopStart + 1.0;
+		position = v->loopStart + Math::fmod(position - v->loopStart, loop_length);
+	}
+	if (position >= (double)region->end) {
+		tsf_voice_kill(v);
+		return;
+	}
+	v->sourceSamplePosition = position;
+}
+
+int tsf_ext_channel_note_on(tsf *p_tsf, int p_channel, int p_key, float p_vel, unsigned int *r_play_index) {
+	unsigned int play_index = p_tsf->voicePlayIndex;
+	if (!tsf_channel_note_on(p_tsf, p_channel, p_key, p_vel) || !tsf_ext_has_play_index(p_tsf, play_index)) {
+		return 0;
+	}
+	*r_play_index = play_index;
+	return 1;
+}
+
+int tsf_ext_channel_note_on_at(tsf *p_tsf, int p_channel, int p_key, float p_vel, double p_offset_seconds) {
+	// every voice started by one note on shares the play index
+	unsigned int play_index = p_tsf->voicePlayIndex;
+	int result = tsf_channel_note_on(p_tsf, p_channel, p_key, p_vel);
+
+	double samples = p_offset_seconds * p_tsf->outSampleRate;
+	if (!result || samples < 1.0) {
+		return result;
+	}
+	// hours in, a sustained loop is as good as anywhere
+	int skip = samples < 0x7FFFFFFF ? (int)samples : 0x7FFFFFFF;
+
+	struct tsf_voice *v = p_tsf->voices, *v_end = v + p_tsf->voiceNum;
+	for (; v != v_end; v++) {
+		if (v->playingPreset != -1 && v->playIndex == play_index) {
+			tsf_ext_voice_skip(v, skip, p_tsf->outSampleRate);
+		}
+	}
+	return result;
+}
+
+static inline float tsf_ext_hermite(const float *p_input, unsigned int p_prev, unsigned int p_pos, unsigned int p_next, unsigned int p_next2, float p_alpha) {
+	float xm1 = p_input[p_prev], x0 = p_input[p_pos], x1 = p_input[p_next], x2 = p_input[p_next2];
+	float c1 = 0.5f * (x1 - xm1);
+	float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+	float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+	return ((c3 * p_alpha + c2) * p_alpha + c1) * p_alpha + x0;
+}
+
+// tsf_voice_render for TSF_STEREO_INTERLEAVED, with the interpolation and filter picked by p_quality
+static void tsf_ext_voice_render(tsf *p_tsf, struct tsf_voice *v, float *p_output, int p_samples, int p_quality) {
+	struct tsf_region *region = v->region;
+	const float *input = p_tsf->fontSamples;
+	float *out = p_output;
+
+	bool filter = p_quality != TSF_EXT_QUALITY_LOW;
+	bool hermite = p_quality == TSF_EXT_QUALITY_HIGH;
+
+	bool update_mod_env = region->modEnvToPitch || region->modEnvToFilterFc;
+	bool update_mod_lfo = v->modlfo.delta && (region->modLfoToPitch || region->modLfoToFilterFc || region->modLfoToVolume);
+	bool update_vib_lfo = v->viblfo.delta && region->vibLfoToPitch;
+	bool looping = v->loopStart < v->loopEnd;
+	unsigned int loop_start = v->loopStart, loop_end = v->loopEnd;
+	double sample_end = (double)region->end, loop_end_position = (double)loop_end + 1.0;
+	double position = v->sourceSamplePosition;
+	float sample_rate = p_tsf->outSampleRate;
+
+	struct tsf_voice_lowpass lowpass = v->lowpass;
+	if (!filter) {
+		lowpass.active = 0;
+	}
+	bool dynamic_lowpass = filter && (region->modLfoToFilterFc || region->modEnvToFilterFc);
+	bool dynamic_pitch = region->modLfoToPitch || region->modEnvToPitch || region->vibLfoToPitch;
+	bool dynamic_gain = region->modLfoToVolume != 0;
+
+	double pitch_ratio = dynamic_pitch ? 0.0 : tsf_timecents2Secsd(v->pitchInputTimecents) * v->pitchOutputFactor;
+	float note_gain = dynamic_gain ? 0.0f : tsf_decibelsToGain(v->noteGainDB);
+
+	while (p_samples) {
+		int block = p_samples > TSF_RENDER_EFFECTSAMPLEBLOCK ? TSF_RENDER_EFFECTSAMPLEBLOCK : p_samples;
+		p_samples -= block;
+
+		if (dynamic_lowpass) {
+			float fres = (float)region->initialFilterFc + v->modlfo.level * region->modLfoToFilterFc + v->modenv.level * region->modEnvToFilterFc;
+			float lowpass_fc = fres <= 13500 ? tsf_cents2Hertz(fres) / sample_rate : 1.0f;
+			lowpass.active = lowpass_fc < 0.499f;
+			if (lowpass.active) {
+				tsf_voice_lowpass_setup(&lowpass, lowpass_fc);
+			}
+		}
+		if (dynamic_pitch) {
+			pitch_ratio = tsf_timecents2Secsd(v->pitchInputTimecents + (v->modlfo.level * region->modLfoToPitch + v->viblfo.level * region->vibLfoToPitch + v->modenv.level * region->modEnvToPitch)) * v->pitchOutputFactor;
+		}
+		if (dynamic_gain) {
+			note_gain = tsf_decibelsToGain(v->noteGainDB + v->modlfo.level * region->modLfoToVolume * 0.1f);
+		}
+
+		float gain = note_gain * v->ampenv.level;
+		float gain_left = gain * v->panFactorLeft, gain_right = gain * v->panFactorRight;
+
+		tsf_voice_envelope_process(&v->ampenv, block, sample_rate);
+		if (update_mod_env) {
+			tsf_voice_envelope_process(&v->modenv, block, sample_rate);
+		}
+		if (update_mod_lfo) {
+			tsf_voice_lfo_process(&v->modlfo, block);
+		}
+		if (update_vib_lfo) {
+			tsf_voice_lfo_process(&v->viblfo, block);
+		}
+
+		while (block-- && position < sample_end) {
+			unsigned int pos = (unsigned int)position;
+			unsigned int next = (pos >= loop_end && looping) ? loop_start : pos + 1;
+			float alpha = (float)(position - pos);
+
+			float value;
+			if (hermite) {
+				// samples are followed by at least 46 zero frames, reading past the end is safe
+				unsigned int prev = pos > 0 ? pos - 1 : 0;
+				unsigned int next2 = (next >= loop_end && looping) ? loop_start : next + 1;
+				value = tsf_ext_hermite(input, prev, pos, next, next2, alpha);
+			} else {
+				value = input[pos] * (1.0f - alpha) + input[next] * alpha;
+			}
+			if (lowpass.active) {
+				value = tsf_voice_lowpass_process(&lowpass, value);
+			}
+
+			*out++ += value * gain_left;
+			*out++ += value * gain_right;
+
+			position += pitch_ratio;
+			if (position >= loop_end_position && looping) {
+				position -= (loop_end - loop_start + 1.0);
+			}
+		}
+
+		if (position >= sample_end || v->ampenv.segment == TSF_SEGMENT_DONE) {
+			tsf_voice_kill(v);
+			return;
+		}
+	}
+
+	v->sourceSamplePosition = position;
+	if (filter && (lowpass.active || dynamic_lowpass)) {
+		v->lowpass = lowpass;
+	}
+}
+
+static inline void tsf_ext_render_voice(tsf *p_tsf, struct tsf_voice *v, float *p_output, int p_samples, int p_quality) {
+	if (p_quality == TSF_EXT_QUALITY_NORMAL || p_tsf->outputmode != TSF_STEREO_INTERLEAVED) {
+		tsf_voice_render(p_tsf, v, p_output, p_samples);
+	} else {
+		tsf_ext_voice_render(p_tsf, v, p_output, p_samples, p_quality);
+	}
+}
+
+void tsf_ext_render_float(tsf *p_tsf, float *p_buffer, int p_samples, int p_flag_mixing, int p_quality) {
+	if (!p_flag_mixing) {
+		memset(p_buffer, 0, 2 * sizeof(float) * p_samples);
+	}
+	struct tsf_voice *v = p_tsf->voices, *v_end = v + p_tsf->voiceNum;
+	for (; v != v_end; v++) {
+		if (v->playingPreset != -1) {
+			tsf_ext_render_voice(p_tsf, v, p_buffer, p_samples, p_quality);
+		}
+	}
+}
+
+bool tsf_ext_render_groups(tsf *p_tsf, float *const *p_outputs, int p_group_count, const uint8_t *p_channel_groups, int p_channel_count, const tsf_ext_sends *p_sends, const tsf_ext_gains *p_gains, int p_samples, int p_quality) {
+	for (int i = 0; i < p_group_count; i++) {
+		memset(p_outputs[i], 0, 2 * sizeof(float) * p_samples);
+	}
+	if (p_sends) {
+		memset(p_sends->reverb, 0, sizeof(float) * p_samples);
+		memset(p_sends->chorus, 0, sizeof(float) * p_samples);
+	}
+
+	bool sent = false;
+
+	struct tsf_voice *v = p_tsf->voices, *v_end = v + p_tsf->voiceNum;
+	for (; v != v_end; v++) {
+		if (v->playingPreset == -1) {
+			continue;
+		}
+		int group = (v->playingChannel >= 0 && v->playingChannel < p_channel_count) ? p_channel_groups[v->playingChannel] : 0;
+		if (group >= p_group_count) {
+			group = 0;
+		}
+
+		int channel = v->playingChannel;
+		float reverb = 0.0f, chorus = 0.0f;
+		if (p_sends && channel >= 0 && channel < p_sends->channel_count) {
+			reverb = p_sends->reverb_levels[channel];
+			chorus = p_sends->chorus_levels[channel];
+		}
+		float gain_from = 1.0f, gain_to = 1.0f;
+		if (p_gains && channel >= 0 && channel < p_gains->channel_count) {
+			gain_from = p_gains->from[channel];
+			gain_to = p_gains->to[channel];
+		}
+		bool ramp = gain_from != 1.0f || gain_to != 1.0f;
+		bool send = reverb != 0.0f || chorus != 0.0f;
+		if (!ramp && !send) {
+			tsf_ext_render_voice(p_tsf, v, p_outputs[group], p_samples, p_quality);
+			continue;
+		}
+
+		// render alone once, then add to the dry output and to the mono sends
+		float *scratch = ramp ? p_gains->scratch : p_sends->scratch;
+		memset(scratch, 0, 2 * sizeof(float) * p_samples);
+		tsf_ext_render_voice(p_tsf, v, scratch, p_samples, p_quality);
+		if (gain_from == 0.0f && gain_to == 0.0f) {
+			// kept running while silent, nothing to add
+			continue;
+		}
+
+		float *out = p_outputs[group];
+		float gain = gain_from;
+		float gain_step = (gain_to - gain_from) / p_samples;
+		reverb *= 0.5f;
+		chorus *= 0.5f;
+		for (int i = 0; i < p_samples; i++) {
+			gain += gain_step;
+			float l = scratch[i * 2] * gain, r = scratch[i * 2 + 1] * gain;
+			out[i * 2] += l;
+			out[i * 2 + 1] += r;
+			if (send) {
+				p_sends->reverb[i] += (l + r) * reverb;
+				p_sends->chorus[i] += (l + r) * chorus;
+			}
+		}
+		sent = sent || send;
+	}
+	return sent;
+}
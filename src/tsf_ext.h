@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+	helpers on top of TinySoundFont that need its internal structures.
+	they live in tsf_ext.cpp, which is also the translation unit holding the
+	TinySoundFont implementation (TSF_IMPLEMENTATION).
+*/
+
+#include <stdint.h>
+
+struct tsf;
+
+enum tsf_ext_quality {
+	TSF_EXT_QUALITY_LOW, // linear interpolation, no per-voice filter
+	TSF_EXT_QUALITY_NORMAL, // tsf_voice_render as is: linear interpolation and filter
+	TSF_EXT_QUALITY_HIGH, // 4-point hermite interpolation and filter
+};
+
+// synthesis rate the low quality tier renders at before upsampling to the mix rate
+static const int TSF_EXT_LOW_QUALITY_SAMPLE_RATE = 22050;
+
+// makes sure channels [0, p_count) exist so that later channel calls never allocate
+void tsf_ext_reserve_channels(tsf *p_tsf, int p_count);
+
+// like tsf_reset, but keeps the channel storage allocated and resets it in place
+void tsf_ext_reset(tsf *p_tsf);
+
+// frees every voice at once, without a release. channels keep their programs and controllers
+void tsf_ext_kill_voices(tsf *p_tsf);
+
+// only the channel part of tsf_ext_reset: programs and controllers back to their defaults,
+// sounding voices keep the gain, pan and pitch they have
+void tsf_ext_reset_channels(tsf *p_tsf);
+
+// frees the voices past their attack whose output gain (note, channel volume and envelope)
+// fell below p_min_gain, returns how many were freed
+int tsf_ext_cull_voices(tsf *p_tsf, float p_min_gain);
+
+// tsf_channel_note_on that also gives the play index shared by the new voices, for tsf_ext_note_off_play_index.
+// returns 0 if no voice started
+int tsf_ext_channel_note_on(tsf *p_tsf, int p_channel, int p_key, float p_vel, unsigned int *r_play_index);
+
+// tsf_channel_note_on for a note that started p_offset_seconds ago: the new voices are moved
+// to where they would be by now (sample position and envelopes), voices that already ended are freed
+int tsf_ext_channel_note_on_at(tsf *p_tsf, int p_channel, int p_key, float p_vel, double p_offset_seconds);
+
+// tsf_note_on that keeps within the voice budget set by tsf_set_max_voices: when too few voices
+// are free for the note's regions, the oldest notes are stopped to make room, released ones first.
+// the voices belong to p_channel, which has to be reserved, and take its controllers whatever its
+// preset. r_play_index gets the play index shared by the new voices. returns how many voices were
+// stolen, -1 if no voice started
+int tsf_ext_note_on_stealing(tsf *p_tsf, int p_channel, int p_preset_index, int p_key, float p_vel, unsigned int *r_play_index);
+
+// tsf_note_off for the voices of a single note on, found by their play index
+void tsf_ext_note_off_play_index(tsf *p_tsf, unsigned int p_play_index);
+
+// tsf_render_float with a selectable tsf_ext_quality, stereo interleaved output only
+void tsf_ext_render_float(tsf *p_tsf, float *p_buffer, int p_samples, int p_flag_mixing, int p_quality);
+
+// per channel effect send levels for tsf_ext_render_groups, the send buffers are mono
+struct tsf_ext_sends {
+	const float *reverb_levels;
+	const float *chorus_levels;
+	int channel_count;
+	float *reverb;
+	float *chorus;
+	float *scratch; // stereo interleaved, p_samples long
+};
+
+// per channel gain ramps for tsf_ext_render_groups, linear from `from` to `to` over the block
+struct tsf_ext_gains {
+	const float *from;
+	const float *to; // reached on the last sample
+	int channel_count;
+	float *scratch; // stereo interleaved, p_samples long
+};
+
+// renders every voice into the stereo interleaved output of its channel's group.
+// p_channel_groups maps channel -> group, voices on channels past p_channel_count go to group 0.
+// outputs may alias each other, a group without its own buffer can point at group 0's.
+// with p_sends, voices on channels with a send level are also summed into the sends.
+// with p_gains, voices are scaled by their channel's ramp, sends included.
+// returns whether anything was sent
+bool tsf_ext_render_groups(tsf *p_tsf, float *const *p_outputs, int p_group_count, const uint8_t *p_channel_groups, int p_channel_count, const tsf_ext_sends *p_sends, const tsf_ext_gains *p_gains, int p_samples, int p_quality);
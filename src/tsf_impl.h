@@ -1,10 +1,14 @@
 #ifdef _GDEXTENSION
+#include <godot_cpp/core/math.hpp>
 #include <godot_cpp/core/memory.hpp>
 using namespace godot;
 #else
+#include "core/math/math_funcs.h"
 #include "core/os/memory.h"
 #endif
 
+#include "audio_thread_guard.h"
+
 inline void tsf_memfree(void* p_ptr) {
 	// avoiding godot error when pointer is null
 	if (!p_ptr) {
@@ -13,11 +17,27 @@ inline void tsf_memfree(void* p_ptr) {
 	memfree(p_ptr);
 }
 
+#ifdef MIDI_TRACK_AUDIO_THREAD_ALLOCATIONS
+inline void tsf_tracked_memfree(void* p_ptr) {
+	if (!p_ptr) {
+		return;
+	}
+	audio_thread_guard_free(p_ptr);
+}
+#endif
+
 // use godot memory allocator
 #define TSF_NO_STDIO
+#ifdef MIDI_TRACK_AUDIO_THREAD_ALLOCATIONS
+// debug builds report allocations made from the mix thread
+#define TSF_MALLOC audio_thread_guard_malloc
+#define TSF_REALLOC audio_thread_guard_realloc
+#define TSF_FREE tsf_tracked_memfree
+#else
 #define TSF_MALLOC memalloc
 #define TSF_REALLOC memrealloc
 #define TSF_FREE tsf_memfree
+#endif
 #define TSF_MEMCPY memcpy
 #define TSF_MEMSET memset
 
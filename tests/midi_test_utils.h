@@ -0,0 +1,17 @@
+#pragma once
+
+#include "../src/midi.h"
+
+namespace MIDITestUtils {
+
+// 500 ticks per beat at 120 BPM, so event ticks are the milliseconds the loaded messages play at
+inline Ref<MIDI> load_events(const LocalVector<MIDI::SMFEvent> &p_events) {
+	LocalVector<uint8_t> file;
+	MIDI::encode_smf(p_events, 500, 500000, file);
+	PackedByteArray data;
+	data.resize(file.size());
+	memcpy(data.ptrw(), file.ptr(), file.size());
+	return MIDI::load_from_buffer(data);
+}
+
+} // namespace MIDITestUtils
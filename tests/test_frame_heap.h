@@ -0,0 +1,70 @@
+#pragma once
+
+#include "tests/test_macros.h"
+
+#include "../src/frame_heap.h"
+
+namespace TestFrameHeap {
+
+struct Entry {
+	uint64_t frame;
+	int id;
+};
+
+TEST_CASE("[Modules][MIDI] FrameHeap pops in frame order") {
+	FrameHeap<Entry> heap;
+	heap.resize(64);
+	CHECK(heap.is_empty());
+
+	// a scrambled order with repeated frames
+	uint32_t seed = 12345;
+	for (int i = 0; i < 64; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		heap.push({ (seed >> 16) % 40, i });
+	}
+	CHECK(heap.is_full());
+	CHECK(heap.size() == 64);
+
+	uint64_t last = 0;
+	int popped = 0;
+	while (!heap.is_empty()) {
+		CHECK(heap.first().frame >= last);
+		last = heap.first().frame;
+		heap.pop();
+		popped++;
+	}
+	CHECK(popped == 64);
+}
+
+TEST_CASE("[Modules][MIDI] FrameHeap keeps working as entries come and go") {
+	FrameHeap<Entry> heap;
+	heap.resize(8);
+
+	// like note-offs released block by block while new notes are scheduled
+	uint64_t clock = 0;
+	uint32_t seed = 1;
+	int pushed = 0;
+	int released = 0;
+	for (int block = 0; block < 200; block++) {
+		for (int i = 0; i < 3 && !heap.is_full(); i++) {
+			seed = seed * 1664525u + 1013904223u;
+			heap.push({ clock + (seed >> 16) % 500, pushed++ });
+		}
+		clock += 64;
+		while (!heap.is_empty() && heap.first().frame <= clock) {
+			Entry entry = heap.first();
+			heap.pop();
+			CHECK(entry.frame <= clock);
+			CHECK((heap.is_empty() || heap.first().frame >= entry.frame));
+			released++;
+		}
+	}
+	CHECK(pushed - released == (int)heap.size());
+
+	heap.clear();
+	CHECK(heap.is_empty());
+	heap.push({ 5, 0 });
+	CHECK(heap.first().frame == 5);
+}
+
+} // namespace TestFrameHeap
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "tests/test_macros.h"
+
+#include "../src/midi_input_router.h"
+
+namespace TestMIDIInputRouter {
+
+static Ref<InputEventMIDI> make_note_on(int p_device, int p_channel, int p_pitch, int p_velocity) {
+	Ref<InputEventMIDI> event;
+	event.instantiate();
+	event->set_device(p_device);
+	event->set_channel(p_channel);
+	event->set_message(MIDIMessage::NOTE_ON);
+	event->set_pitch(p_pitch);
+	event->set_velocity(p_velocity);
+	return event;
+}
+
+// channel the event is routed to, -1 if it isn't
+static int routed_channel(MIDIInputRouter *p_router, int p_device, int p_channel) {
+	MIDIInputRouter::RoutedMessage message;
+	if (!p_router->translate_event(make_note_on(p_device, p_channel, 60, 100), message)) {
+		return -1;
+	}
+	return message.channel;
+}
+
+TEST_CASE("[Modules][MIDI] MIDIInputRouter translates channel messages") {
+	MIDIInputRouter *router = memnew(MIDIInputRouter);
+	MIDIInputRouter::RoutedMessage message;
+
+	CHECK(router->translate_event(make_note_on(0, 3, 64, 90), message));
+	CHECK(message.type == 0x90);
+	CHECK(message.channel == 3);
+	CHECK(message.param1 == 64);
+	CHECK(message.param2 == 90);
+
+	Ref<InputEventMIDI> control;
+	control.instantiate();
+	control->set_channel(1);
+	control->set_message(MIDIMessage::CONTROL_CHANGE);
+	control->set_controller_number(7);
+	control->set_controller_value(42);
+	CHECK(router->translate_event(control, message));
+	CHECK(message.type == 0xB0);
+	CHECK(message.param1 == 7);
+	CHECK(message.param2 == 42);
+
+	Ref<InputEventMIDI> clock;
+	clock.instantiate();
+	clock->set_message(MIDIMessage::TIMING_CLOCK);
+	CHECK_FALSE_MESSAGE(router->translate_event(clock, message), "System messages aren't routed.");
+
+	Ref<InputEventKey> key;
+	key.instantiate();
+	CHECK_FALSE(router->translate_event(key, message));
+
+	memdelete(router);
+}
+
+TEST_CASE("[Modules][MIDI] MIDIInputRouter filters by device and channel") {
+	MIDIInputRouter *router = memnew(MIDIInputRouter);
+
+	router->set_channel_enabled(9, false);
+	CHECK(routed_channel(router, 0, 9) == -1);
+	CHECK(routed_channel(router, 0, 8) == 8);
+
+	router->set_device(2);
+	CHECK(routed_channel(router, 1, 8) == -1);
+	CHECK(routed_channel(router, 2, 8) == 8);
+
+	router->set_output_channel(200);
+	CHECK(routed_channel(router, 2, 8) == 200);
+
+	memdelete(router);
+}
+
+TEST_CASE("[Modules][MIDI] MIDIInputRouter routes") {
+	MIDIInputRouter *router = memnew(MIDIInputRouter);
+	router->set_channel_mask(0);
+
+	SUBCASE("A route bypasses the device and channel filters") {
+		router->set_route(1, -1, MIDIInputRouter::OUTPUT_KEEP);
+		CHECK(routed_channel(router, 1, 5) == 5);
+		CHECK(routed_channel(router, 0, 5) == -1);
+	}
+
+	SUBCASE("The most specific route wins") {
+		router->set_route(-1, -1, 0);
+		router->set_route(-1, 9, 10);
+		router->set_route(1, -1, 20);
+		router->set_route(1, 9, 30);
+		CHECK(routed_channel(router, 0, 0) == 0);
+		CHECK(routed_channel(router, 0, 9) == 10);
+		CHECK(routed_channel(router, 1, 0) == 20);
+		CHECK(routed_channel(router, 1, 9) == 30);
+	}
+
+	SUBCASE("Dropped events aren't routed") {
+		router->set_channel_mask(MIDIInputRouter::ALL_CHANNELS);
+		router->set_route(1, -1, MIDIInputRouter::OUTPUT_DROP);
+		CHECK(routed_channel(router, 1, 0) == -1);
+		CHECK(routed_channel(router, 0, 0) == 0);
+	}
+
+	SUBCASE("Setting a route again replaces it") {
+		router->set_route(1, 2, 3);
+		router->set_route(1, 2, 4);
+		CHECK(router->has_route(1, 2));
+		CHECK(routed_channel(router, 1, 2) == 4);
+
+		router->remove_route(1, 2);
+		CHECK_FALSE(router->has_route(1, 2));
+		CHECK(routed_channel(router, 1, 2) == -1);
+
+		router->set_route(1, 2, 3);
+		router->clear_routes();
+		CHECK_FALSE(router->has_route(1, 2));
+	}
+
+	memdelete(router);
+}
+
+TEST_CASE("[Modules][MIDI] MIDIInputRouter without a target") {
+	MIDIInputRouter *router = memnew(MIDIInputRouter);
+	CHECK_FALSE_MESSAGE(router->route_midi_event(make_note_on(0, 0, 60, 100)), "Nothing to route to without a player or a playback.");
+
+	router->set_player(NodePath("Player"));
+	CHECK_FALSE_MESSAGE(router->route_midi_event(make_note_on(0, 0, 60, 100)), "The player isn't looked up outside of the tree.");
+
+	memdelete(router);
+}
+
+} // namespace TestMIDIInputRouter
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "tests/test_macros.h"
+
+#include "midi_test_utils.h"
+
+#include "../src/midi.h"
+#include "../thirdparty/tinysoundfont/tml.h"
+
+namespace TestMIDILoopState {
+
+TEST_CASE("[Modules][MIDI] Channel state at a loop start") {
+	LocalVector<MIDI::SMFEvent> events;
+	events.push_back({ 0, 0xB0, 0, 0, 1 }); // bank select
+	events.push_back({ 0, 0xC0, 0, 3, 0 });
+	events.push_back({ 100, 0xB0, 0, 7, 50 });
+	events.push_back({ 200, 0xB0, 0, 7, 80 });
+	events.push_back({ 300, 0xE0, 1, 9000, 0 });
+	events.push_back({ 400, 0xC0, 0, 4, 0 });
+	events.push_back({ 500, 0x90, 0, 60, 100 });
+	events.push_back({ 1000, 0xB0, 0, 7, 20 });
+	events.push_back({ 1500, 0x80, 0, 60, 0 });
+
+	Ref<MIDI> midi = MIDITestUtils::load_events(events);
+	REQUIRE(midi.is_valid());
+
+	LocalVector<tml_message *> state;
+
+	SUBCASE("The last value of each, in file order") {
+		tml_message *start = midi->get_state_before(1000.0, state);
+		REQUIRE(start);
+		CHECK(start->time == 1000);
+		CHECK(start->type == TML_CONTROL_CHANGE);
+
+		REQUIRE(state.size() == 4);
+		CHECK_MESSAGE((state[0]->type == TML_CONTROL_CHANGE && state[0]->control == 0), "The bank select stays ahead of the program change.");
+		CHECK((state[1]->type == TML_CONTROL_CHANGE && state[1]->control == 7 && state[1]->control_value == 80));
+		CHECK((state[2]->type == TML_PITCH_BEND && state[2]->channel == 1 && state[2]->pitch_bend == 9000));
+		CHECK((state[3]->type == TML_PROGRAM_CHANGE && state[3]->program == 4));
+	}
+
+	SUBCASE("Nothing before the start of the song") {
+		state.push_back(nullptr);
+		CHECK(midi->get_state_before(0.0, state) == midi->get_midi());
+		CHECK(state.is_empty());
+	}
+
+	SUBCASE("Past the end of the song") {
+		CHECK(midi->get_state_before(5000.0, state) == nullptr);
+		REQUIRE(state.size() == 4);
+		CHECK((state[3]->type == TML_CONTROL_CHANGE && state[3]->control_value == 20));
+	}
+}
+
+} // namespace TestMIDILoopState
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "tests/test_macros.h"
+
+#include "midi_test_utils.h"
+
+#include "../src/midi.h"
+#include "../thirdparty/tinysoundfont/tml.h"
+
+namespace TestMIDINoteIndex {
+
+static int count_notes_at(const Ref<MIDI> &p_midi, double p_msec) {
+	int count = 0;
+	p_midi->get_notes_at(p_msec, [&](const MIDI::NoteSpan &p_span) {
+		CHECK(p_span.start_msec <= p_msec);
+		CHECK(p_span.end_msec > p_msec);
+		count++;
+	});
+	return count;
+}
+
+// the same question answered by replaying the song from the start
+static int count_notes_replayed(const Ref<MIDI> &p_midi, double p_msec) {
+	LocalVector<int> open;
+	open.resize(p_midi->get_channel_count() * 128);
+	for (uint32_t i = 0; i < open.size(); i++) {
+		open[i] = 0;
+	}
+	for (tml_message *msg = p_midi->get_midi(); msg && msg->time <= p_msec; msg = msg->next) {
+		if (msg->type != TML_NOTE_ON && msg->type != TML_NOTE_OFF) {
+			continue;
+		}
+		int &slot = open[msg->channel * 128 + msg->key];
+		if (msg->type == TML_NOTE_ON && msg->velocity > 0) {
+			slot++;
+		} else {
+			slot = 0;
+		}
+	}
+	int count = 0;
+	for (uint32_t i = 0; i < open.size(); i++) {
+		count += open[i];
+	}
+	return count;
+}
+
+TEST_CASE("[Modules][MIDI] Notes sounding at a time") {
+	LocalVector<MIDI::SMFEvent> events;
+	events.push_back({ 0, 0x90, 0, 60, 100 }); // held across checkpoints
+	events.push_back({ 100, 0x90, 0, 67, 100 });
+	events.push_back({ 200, 0x90, 0, 67, 100 }); // the same key again, one note off releases both
+	events.push_back({ 300, 0x80, 0, 67, 0 });
+	events.push_back({ 2500, 0x90, 1, 62, 100 });
+	events.push_back({ 2600, 0x90, 1, 62, 0 }); // note on with velocity 0 releases
+	events.push_back({ 4000, 0x90, 2, 64, 100 }); // never released
+	events.push_back({ 5000, 0x80, 0, 60, 0 });
+	events.push_back({ 7000, 0xB0, 0, 7, 100 });
+	Ref<MIDI> midi = MIDITestUtils::load_events(events);
+	REQUIRE(midi.is_valid());
+
+	CHECK(count_notes_at(midi, -1.0) == 0);
+	CHECK(count_notes_at(midi, 0.0) == 1);
+	CHECK(count_notes_at(midi, 250.0) == 3);
+	CHECK_MESSAGE(count_notes_at(midi, 300.0) == 1, "A note released at the time isn't sounding.");
+	CHECK(count_notes_at(midi, 2550.0) == 2);
+	CHECK(count_notes_at(midi, 2600.0) == 1);
+	CHECK(count_notes_at(midi, 4500.0) == 2);
+	CHECK(count_notes_at(midi, 5000.0) == 1);
+	CHECK_MESSAGE(count_notes_at(midi, 9000.0) == 1, "A note never released sounds past the end of the song.");
+}
+
+TEST_CASE("[Modules][MIDI] Notes sounding at a time match replaying the song") {
+	// overlapping notes on a few keys, so repeated note ons and early releases are common
+	LocalVector<MIDI::SMFEvent> events;
+	uint32_t seed = 7;
+	uint32_t tick = 0;
+	for (int i = 0; i < 600; i++) {
+		seed = seed * 1664525u + 1013904223u;
+		tick += (seed >> 16) % 90;
+		uint8_t channel = (seed >> 8) % 3;
+		uint16_t key = 60 + (seed >> 4) % 4;
+		bool note_on = (seed >> 12) % 3 != 0;
+		events.push_back({ tick, uint8_t(note_on ? 0x90 : 0x80), channel, key, uint8_t(note_on ? 100 : 0) });
+	}
+	Ref<MIDI> midi = MIDITestUtils::load_events(events);
+	REQUIRE(midi.is_valid());
+
+	for (double msec = 0.0; msec < tick + 3000.0; msec += 37.0) {
+		CHECK(count_notes_at(midi, msec) == count_notes_replayed(midi, msec));
+	}
+}
+
+} // namespace TestMIDINoteIndex
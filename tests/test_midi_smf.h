@@ -0,0 +1,107 @@
+#pragma once
+
+#include "tests/test_macros.h"
+
+#include "midi_test_utils.h"
+
+#include "../src/midi.h"
+#include "../src/midi_recorder.h"
+#include "../thirdparty/tinysoundfont/tml.h"
+
+namespace TestMIDISMF {
+
+struct Expected {
+	uint32_t msec;
+	int type;
+	int channel;
+	int data1;
+	int data2;
+};
+
+// channel voice messages of p_midi in song order, pitch bend as a single 14-bit value in data1
+static void check_messages(const Ref<MIDI> &p_midi, const Expected *p_expected, int p_count) {
+	int i = 0;
+	for (tml_message *msg = p_midi->get_midi(); msg; msg = msg->next) {
+		if (msg->type < 0x80 || msg->type >= 0xF0) {
+			continue;
+		}
+		REQUIRE(i < p_count);
+		const Expected &expected = p_expected[i++];
+		// tml rounds ticks down to milliseconds, the recorder's ticks aren't whole ones
+		CHECK(ABS((int)msg->time - (int)expected.msec) <= 1);
+		CHECK(msg->type == expected.type);
+		CHECK(msg->channel == expected.channel);
+		switch (msg->type) {
+			case TML_PITCH_BEND:
+				CHECK(msg->pitch_bend == expected.data1);
+				break;
+			case TML_PROGRAM_CHANGE:
+				CHECK(msg->program == expected.data1);
+				break;
+			case TML_CONTROL_CHANGE:
+				CHECK(msg->control == expected.data1);
+				CHECK(msg->control_value == expected.data2);
+				break;
+			default:
+				CHECK(msg->key == expected.data1);
+				CHECK(msg->velocity == expected.data2);
+				break;
+		}
+	}
+	CHECK(i == p_count);
+}
+
+TEST_CASE("[Modules][MIDI] Encoded files load back") {
+	LocalVector<MIDI::SMFEvent> events;
+	events.push_back({ 0, 0xC0, 0, 5, 0 });
+	events.push_back({ 0, 0x90, 0, 60, 100 });
+	events.push_back({ 100, 0xB0, 1, 7, 90 });
+	events.push_back({ 200, 0xE0, 0, 12000, 0 });
+	events.push_back({ 240, 0x90, 17, 64, 80 }); // second port
+	events.push_back({ 480, 0x80, 0, 60, 0 });
+	events.push_back({ 720, 0x80, 17, 64, 0 });
+
+	Ref<MIDI> midi = MIDITestUtils::load_events(events);
+	REQUIRE(midi.is_valid());
+	CHECK(midi->get_channel_count() == 32);
+
+	const Expected expected[] = {
+		{ 0, TML_PROGRAM_CHANGE, 0, 5, 0 },
+		{ 0, TML_NOTE_ON, 0, 60, 100 },
+		{ 100, TML_CONTROL_CHANGE, 1, 7, 90 },
+		{ 200, TML_PITCH_BEND, 0, 12000, 0 },
+		{ 240, TML_NOTE_ON, 17, 64, 80 },
+		{ 480, TML_NOTE_OFF, 0, 60, 0 },
+		{ 720, TML_NOTE_OFF, 17, 64, 0 },
+	};
+	check_messages(midi, expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+TEST_CASE("[Modules][MIDI] Recorded messages load back") {
+	// at this rate a frame is a millisecond
+	MIDIRecorder recorder;
+	recorder.start(64, 1000.0f);
+	recorder.record(0, 0x90, 3, 50, 90);
+	recorder.record(100, 0xB0, 3, 64, 127);
+	recorder.record(300, 0x80, 3, 50, 0);
+	recorder.record(400, 0x90, 200, 70, 100); // held until the end
+	recorder.record(500, 0xF0, 0, 0, 0); // system messages aren't recorded
+	recorder.set_clock(1000);
+	recorder.stop();
+	CHECK(recorder.get_dropped_count() == 0);
+
+	Ref<MIDI> midi = recorder.get_midi();
+	REQUIRE(midi.is_valid());
+	CHECK_MESSAGE(midi->get_channel_count() == 208, "Channel 200 keeps its number, every port up to it is written.");
+
+	const Expected expected[] = {
+		{ 0, TML_NOTE_ON, 3, 50, 90 },
+		{ 100, TML_CONTROL_CHANGE, 3, 64, 127 },
+		{ 300, TML_NOTE_OFF, 3, 50, 0 },
+		{ 400, TML_NOTE_ON, 200, 70, 100 },
+		{ 1000, TML_NOTE_OFF, 200, 70, 0 },
+	};
+	check_messages(midi, expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+} // namespace TestMIDISMF
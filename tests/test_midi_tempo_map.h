@@ -0,0 +1,59 @@
+#pragma once
+
+#include "tests/test_macros.h"
+
+#include "../src/midi.h"
+
+namespace TestMIDITempoMap {
+
+static Ref<MIDI> make_midi(const uint8_t *p_track, int p_size) {
+	// format 0, 500 ticks per beat
+	const uint8_t header[] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xF4, 'M', 'T', 'r', 'k', 0, 0, uint8_t(p_size >> 8), uint8_t(p_size) };
+	PackedByteArray data;
+	data.resize(sizeof(header) + p_size);
+	memcpy(data.ptrw(), header, sizeof(header));
+	memcpy(data.ptrw() + sizeof(header), p_track, p_size);
+	return MIDI::load_from_buffer(data);
+}
+
+TEST_CASE("[Modules][MIDI] Beats follow tempo changes") {
+	const uint8_t track[] = {
+		0x00, 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20, // 120 BPM
+		0x87, 0x68, 0xFF, 0x51, 0x03, 0x0F, 0x42, 0x40, // 60 BPM from beat 2
+		0x87, 0x68, 0x90, 0x3C, 0x64, // a note at beat 4
+		0x00, 0xFF, 0x2F, 0x00
+	};
+	Ref<MIDI> midi = make_midi(track, sizeof(track));
+	REQUIRE(midi.is_valid());
+
+	CHECK(midi->get_beat_time(0.0) == doctest::Approx(0.0));
+	CHECK(midi->get_beat_time(1.0) == doctest::Approx(0.5));
+	CHECK(midi->get_beat_time(2.0) == doctest::Approx(1.0));
+	CHECK(midi->get_beat_time(3.0) == doctest::Approx(2.0));
+	CHECK(midi->get_beat_time(4.0) == doctest::Approx(3.0));
+
+	CHECK(midi->get_beat_at(0.5) == doctest::Approx(1.0));
+	CHECK(midi->get_beat_at(1.0) == doctest::Approx(2.0));
+	CHECK(midi->get_beat_at(1.5) == doctest::Approx(2.5));
+	CHECK_MESSAGE(midi->get_beat_at(5.0) == doctest::Approx(6.0), "The last tempo holds past the end of the song.");
+
+	for (double beat = 0.0; beat < 8.0; beat += 0.25) {
+		CHECK(midi->get_beat_at(midi->get_beat_time(beat)) == doctest::Approx(beat));
+	}
+}
+
+TEST_CASE("[Modules][MIDI] Beats without a tempo event") {
+	const uint8_t track[] = {
+		0x00, 0x90, 0x3C, 0x64,
+		0x83, 0x74, 0x80, 0x3C, 0x00,
+		0x00, 0xFF, 0x2F, 0x00
+	};
+	Ref<MIDI> midi = make_midi(track, sizeof(track));
+	REQUIRE(midi.is_valid());
+
+	// 120 BPM, as the standard says
+	CHECK(midi->get_beat_time(1.0) == doctest::Approx(0.5));
+	CHECK(midi->get_beat_at(2.0) == doctest::Approx(4.0));
+}
+
+} // namespace TestMIDITempoMap